@@ -73,3 +73,54 @@ TEST_F(SyntaxTreeTest, TreeTest) {
 
   ast::construct_syntax_tree(tokens, parser_outputs);
 }
+
+TEST_F(SyntaxTreeTest, TreeFromTokenBuffer) {
+  auto input_string = "(123+3454)*(213*13)";
+  auto tokens = tokenizer_for_lang.tokenize_all(input_string);
+
+  parser.parse(tokens);
+  std::vector<std::pair<parser::ParsingActionType, parser::Production>>
+      parser_outputs;
+  while (!parser.has_accepted() && !parser.is_stuck()) {
+    parser_outputs.push_back(parser.make_next_move());
+  }
+
+  auto root = ast::construct_syntax_tree(tokens, parser_outputs);
+  auto children = root.get_children();
+  ASSERT_EQ(children.size(), 2);
+  EXPECT_EQ(root.get_data(), "*");
+  EXPECT_EQ(children[0].get_data(), "+");
+  EXPECT_EQ(children[0].get_children()[1].get_data(), "3454");
+  EXPECT_EQ(children[1].get_data(), "*");
+  EXPECT_EQ(children[1].get_children()[0].get_data(), "213");
+}
+
+TEST_F(SyntaxTreeTest, LeavesKeepIdentifierSymbols) {
+  auto id_productions = productions;
+  id_productions.push_back(parser::Production("factor", {"id"}));
+  parser::Parser id_parser(parser::Grammar(id_productions, "expr'"));
+  auto input_string = "x*(y+x)+1";
+  tokenizer::SymbolTable symbol_table;
+  auto tokens = tokenizer_for_lang.tokenize_all(input_string, &symbol_table);
+
+  id_parser.parse(tokens);
+  std::vector<std::pair<parser::ParsingActionType, parser::Production>>
+      parser_outputs;
+  while (!id_parser.has_accepted() && !id_parser.is_stuck()) {
+    parser_outputs.push_back(id_parser.make_next_move());
+  }
+
+  auto root = ast::construct_syntax_tree(tokens, parser_outputs);
+  ASSERT_EQ(root.get_data(), "+");
+  auto product = root.get_children()[0];
+  ASSERT_EQ(product.get_data(), "*");
+  auto x = product.get_children()[0];
+  auto sum = product.get_children()[1];
+  ASSERT_EQ(sum.get_data(), "+");
+  EXPECT_EQ(x.get_symbol(), symbol_table.find("x"));
+  EXPECT_EQ(sum.get_children()[0].get_symbol(), symbol_table.find("y"));
+  EXPECT_EQ(sum.get_children()[1].get_symbol(), x.get_symbol());
+  EXPECT_EQ(root.get_children()[1].get_symbol(),
+            tokenizer::SymbolTable::kNoSymbol);
+  EXPECT_EQ(root.get_symbol(), tokenizer::SymbolTable::kNoSymbol);
+}
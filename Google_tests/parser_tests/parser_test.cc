@@ -180,3 +180,17 @@ TEST_F(ParserTest, ParserConstructorTest3) {
   EXPECT_TRUE(parser.has_accepted());
   EXPECT_FALSE(parser.is_stuck());
 }
+
+TEST_F(ParserTest, ParseTokenBuffer) {
+  auto tokens_to_parse = tok.tokenize_all("(123+1232)*(854+45)");
+
+  parser.parse(tokens_to_parse);
+  std::vector<std::pair<parser::ParsingActionType, parser::Production>>
+      parser_outputs;
+  while (!parser.has_accepted() && !parser.is_stuck()) {
+    parser_outputs.push_back(parser.make_next_move());
+  }
+
+  EXPECT_TRUE(parser.has_accepted());
+  EXPECT_FALSE(parser.is_stuck());
+}
@@ -0,0 +1,134 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tokenizer/automaton_file.h"
+#include "tokenizer/regular_expression.h"
+
+class AutomatonFileTest : public ::testing::Test {
+ protected:
+  std::string path;
+  tokenizer::DeterministicFiniteAutomaton automaton;
+
+  void SetUp() override {
+    path = ::testing::TempDir() + "automaton_file_test.dfa";
+    tokenizer::RegularExpression regex("[a-z][a-z0-9]*");
+    automaton = regex.convert_to_nfa().convert_to_dfa().minimize();
+  }
+
+  void TearDown() override {
+    std::remove(path.c_str());
+  }
+
+  void flip_last_byte() {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(-1, std::ios::end);
+    auto last_byte = static_cast<char>(file.get());
+    file.seekp(-1, std::ios::end);
+    file.put(static_cast<char>(last_byte ^ 1));
+  }
+};
+
+TEST_F(AutomatonFileTest, MappedAutomatonMatchesSavedOne) {
+  ASSERT_EQ(tokenizer::write_automaton_file(path, automaton, 3, {7}), true);
+
+  tokenizer::DeterministicFiniteAutomaton mapped_automaton;
+  int number_of_unminimized_states;
+  std::vector<int> tag_values;
+  ASSERT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      true);
+  EXPECT_EQ(number_of_unminimized_states, 3);
+  EXPECT_EQ(tag_values, std::vector<int>{7});
+  EXPECT_EQ(mapped_automaton.get_number_of_states(),
+            automaton.get_number_of_states());
+  EXPECT_EQ(mapped_automaton.get_self_loop(1).number_of_ranges, 2);
+
+  int final_state_tag;
+  EXPECT_EQ(mapped_automaton.find_longest_match("ab12+", 0, &final_state_tag),
+            4);
+  EXPECT_EQ(final_state_tag, 0);
+  tokenizer::AutomatonCursor cursor(mapped_automaton);
+  cursor.move('1');
+  EXPECT_EQ(cursor.is_dead(), true);
+}
+
+TEST_F(AutomatonFileTest, MappingOutlivesFile) {
+  ASSERT_EQ(tokenizer::write_automaton_file(path, automaton, 3, {0}), true);
+  tokenizer::DeterministicFiniteAutomaton mapped_automaton;
+  int number_of_unminimized_states;
+  std::vector<int> tag_values;
+  ASSERT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      true);
+  std::remove(path.c_str());
+
+  auto copied_automaton = mapped_automaton;
+  mapped_automaton = tokenizer::DeterministicFiniteAutomaton();
+  int final_state_tag;
+  EXPECT_EQ(copied_automaton.find_longest_match("abc", 0, &final_state_tag), 3);
+}
+
+TEST_F(AutomatonFileTest, CorruptFilesAreRejected) {
+  tokenizer::DeterministicFiniteAutomaton mapped_automaton;
+  int number_of_unminimized_states = -1;
+  std::vector<int> tag_values;
+  EXPECT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      false);
+
+  ASSERT_EQ(tokenizer::write_automaton_file(path, automaton, 3, {0}), true);
+  flip_last_byte();
+  EXPECT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      false);
+
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "ROADYDFA";
+  EXPECT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      false);
+  EXPECT_EQ(number_of_unminimized_states, -1);
+  EXPECT_EQ(mapped_automaton.get_number_of_states(), 1);
+}
+
+TEST_F(AutomatonFileTest, SelfLoopsMustMatchTheTable) {
+  // The checksum is right, but state 1 claims to loop on every byte, so
+  // find_self_loop_end would skip the '+' of "ab+c".
+  auto self_loops = automaton.get_self_loops();
+  std::vector<tokenizer::SelfLoop> wrong_self_loops(
+      std::begin(self_loops), std::end(self_loops));
+  wrong_self_loops[1] = tokenizer::SelfLoop{1, {0}, {255}};
+  tokenizer::DeterministicFiniteAutomaton wrong_automaton(
+      nullptr, automaton.get_start_state(), automaton.get_number_of_classes(),
+      automaton.get_byte_classes(), automaton.get_transition_table(),
+      automaton.get_final_state_tags(), wrong_self_loops);
+  ASSERT_EQ(tokenizer::write_automaton_file(path, wrong_automaton, 3, {0}),
+            true);
+
+  tokenizer::DeterministicFiniteAutomaton mapped_automaton;
+  int number_of_unminimized_states;
+  std::vector<int> tag_values;
+  EXPECT_EQ(tokenizer::map_automaton_file(
+      path, &mapped_automaton, &number_of_unminimized_states, &tag_values),
+      false);
+}
+
+TEST_F(AutomatonFileTest, FailedWritesLeaveNoTemporaryFile) {
+  // Renaming the written file over a directory fails.
+  std::filesystem::path directory_path = path + ".dir";
+  std::filesystem::create_directory(directory_path);
+  EXPECT_EQ(tokenizer::write_automaton_file(
+      directory_path.string(), automaton, 3, {0}), false);
+
+  auto prefix = directory_path.filename().string() + ".";
+  for (const auto& entry : std::filesystem::directory_iterator(
+           directory_path.parent_path())) {
+    EXPECT_NE(entry.path().filename().string().rfind(prefix, 0), 0)
+        << entry.path();
+  }
+  std::filesystem::remove(directory_path);
+}
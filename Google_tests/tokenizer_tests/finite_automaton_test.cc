@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <memory>
+
 #include "tokenizer/finite_automaton.h"
 
 class FiniteAutomatonTest : public ::testing::Test {
@@ -20,35 +22,269 @@ class FiniteAutomatonTest : public ::testing::Test {
 };
 
 TEST_F(FiniteAutomatonTest, AutomatonAccepts) {
-  automaton.move("c");
-  automaton.move("b");
-  automaton.move("a");
-  automaton.move("b");
-  automaton.move("a");
+  tokenizer::AutomatonCursor cursor(automaton);
+  cursor.move("c");
+  cursor.move("b");
+  cursor.move("a");
+  cursor.move("b");
+  cursor.move("a");
 
-  EXPECT_EQ(automaton.has_accepted(), true);
-  EXPECT_EQ(automaton.is_dead(), false);
+  EXPECT_EQ(cursor.has_accepted(), true);
+  EXPECT_EQ(cursor.is_dead(), false);
 }
 
 TEST_F(FiniteAutomatonTest, AutomatonDies) {
-  automaton.move("c");
-  automaton.move("b");
-  automaton.move("a");
-  automaton.move("b");
-  automaton.move("c");
+  tokenizer::AutomatonCursor cursor(automaton);
+  cursor.move("c");
+  cursor.move("b");
+  cursor.move("a");
+  cursor.move("b");
+  cursor.move("c");
 
-  EXPECT_EQ(automaton.has_accepted(), false);
-  EXPECT_EQ(automaton.is_dead(), true);
+  EXPECT_EQ(cursor.has_accepted(), false);
+  EXPECT_EQ(cursor.is_dead(), true);
 }
 
 TEST_F(FiniteAutomatonTest, AutomatonReset) {
-  automaton.move("c");
-  automaton.move("b");
-  automaton.move("a");
-  automaton.move("b");
-  automaton.move("c");
-  automaton.reset();
-
-  EXPECT_EQ(automaton.has_accepted(), false);
-  EXPECT_EQ(automaton.is_dead(), false);
+  tokenizer::AutomatonCursor cursor(automaton);
+  cursor.move("c");
+  cursor.move("b");
+  cursor.move("a");
+  cursor.move("b");
+  cursor.move("c");
+  cursor.reset();
+
+  EXPECT_EQ(cursor.has_accepted(), false);
+  EXPECT_EQ(cursor.is_dead(), false);
+}
+
+TEST_F(FiniteAutomatonTest, AutomatonMovesOnBytes) {
+  tokenizer::AutomatonCursor cursor(automaton);
+  cursor.move('c');
+  cursor.move('a');
+  cursor.move('b');
+
+  EXPECT_EQ(cursor.has_accepted(), true);
+  EXPECT_EQ(cursor.is_dead(), false);
+
+  cursor.move('\xff');
+
+  EXPECT_EQ(cursor.has_accepted(), false);
+  EXPECT_EQ(cursor.is_dead(), true);
+}
+
+TEST_F(FiniteAutomatonTest, DefaultAutomatonIsDead) {
+  tokenizer::DeterministicFiniteAutomaton default_automaton;
+  tokenizer::AutomatonCursor cursor(default_automaton);
+  cursor.move('a');
+
+  EXPECT_EQ(cursor.has_accepted(), false);
+  EXPECT_EQ(cursor.is_dead(), true);
+}
+
+TEST_F(FiniteAutomatonTest, AlternativesTagFinalStates) {
+  tokenizer::NonDeterministicFiniteAutomaton a_star("a");
+  a_star.apply_star();
+  tokenizer::NonDeterministicFiniteAutomaton a("a");
+  tokenizer::NonDeterministicFiniteAutomaton b("b");
+  tokenizer::NonDeterministicFiniteAutomaton alternatives({a_star, a, b});
+  auto tagged_automaton = alternatives.convert_to_dfa();
+
+  tokenizer::AutomatonCursor cursor(tagged_automaton);
+  cursor.move('a');
+  EXPECT_EQ(cursor.get_final_state_tag(), 0);
+
+  cursor.reset();
+  cursor.move('b');
+  EXPECT_EQ(cursor.get_final_state_tag(), 2);
+
+  cursor.move('b');
+  EXPECT_EQ(cursor.is_dead(), true);
+  EXPECT_EQ(cursor.get_final_state_tag(), -1);
+}
+
+TEST_F(FiniteAutomatonTest, CursorsMoveIndependently) {
+  tokenizer::AutomatonCursor accepting_cursor(automaton);
+  tokenizer::AutomatonCursor dying_cursor(automaton);
+  accepting_cursor.move('c');
+  dying_cursor.move('a');
+  accepting_cursor.move('a');
+
+  EXPECT_EQ(accepting_cursor.has_accepted(), true);
+  EXPECT_EQ(dying_cursor.is_dead(), true);
+  EXPECT_EQ(tokenizer::AutomatonCursor(automaton).get_current_state(),
+            automaton.get_start_state());
+}
+
+TEST_F(FiniteAutomatonTest, MinimizedAutomatonAccepts) {
+  auto minimized_automaton = automaton.minimize();
+  tokenizer::AutomatonCursor cursor(minimized_automaton);
+  cursor.move('c');
+  cursor.move('b');
+  cursor.move('a');
+
+  EXPECT_EQ(minimized_automaton.get_number_of_states(), 2);
+  EXPECT_LT(minimized_automaton.get_number_of_states(),
+            automaton.get_number_of_states());
+  EXPECT_EQ(cursor.has_accepted(), true);
+
+  cursor.move('c');
+
+  EXPECT_EQ(cursor.is_dead(), true);
+}
+
+TEST_F(FiniteAutomatonTest, MinimizationKeepsTagsApart) {
+  tokenizer::NonDeterministicFiniteAutomaton a("a");
+  tokenizer::NonDeterministicFiniteAutomaton b("b");
+  tokenizer::NonDeterministicFiniteAutomaton other_b("b");
+  tokenizer::NonDeterministicFiniteAutomaton alternatives({a, b, other_b});
+  auto tagged_automaton = alternatives.convert_to_dfa().minimize();
+
+  EXPECT_EQ(tagged_automaton.get_number_of_states(), 3);
+  tokenizer::AutomatonCursor cursor(tagged_automaton);
+  cursor.move('a');
+  EXPECT_EQ(cursor.get_final_state_tag(), 0);
+  cursor.reset();
+  cursor.move('b');
+  EXPECT_EQ(cursor.get_final_state_tag(), 1);
+}
+
+TEST_F(FiniteAutomatonTest, SelfLoopsAreMarked) {
+  auto minimized_automaton = automaton.minimize();
+  auto start_self_loop = minimized_automaton.get_self_loop(0);
+  auto star_self_loop = minimized_automaton.get_self_loop(1);
+
+  EXPECT_EQ(start_self_loop.number_of_ranges, 0);
+  ASSERT_EQ(star_self_loop.number_of_ranges, 1);
+  EXPECT_EQ(star_self_loop.range_starts[0], 'a');
+  EXPECT_EQ(star_self_loop.range_ends[0], 'b');
+
+  int final_state_tag;
+  std::string input = "c" + std::string(100, 'a') + "bab" + "c";
+  EXPECT_EQ(minimized_automaton.find_longest_match(input, 0, &final_state_tag),
+            input.size() - 1);
+  EXPECT_EQ(final_state_tag, 0);
+}
+
+TEST_F(FiniteAutomatonTest, SelfLoopSkipMatchesScalarSkip) {
+  tokenizer::SelfLoop self_loop;
+  self_loop.number_of_ranges = 3;
+  self_loop.range_starts[0] = '0';
+  self_loop.range_ends[0] = '9';
+  self_loop.range_starts[1] = 'a';
+  self_loop.range_ends[1] = 'z';
+  self_loop.range_starts[2] = 0xf0;
+  self_loop.range_ends[2] = 0xff;
+
+  std::string input;
+  unsigned int seed = 1;
+  for (auto idx = 0; idx < 4096; ++idx) {
+    seed = seed * 1103515245 + 12345;
+    // Mostly looping bytes so that runs span several vectors.
+    input += (seed >> 16) % 64 == 0 ? static_cast<char>(seed >> 8)
+                                    : static_cast<char>('a' + (seed >> 8) % 26);
+  }
+
+  for (std::size_t offset = 0; offset <= input.size(); ++offset) {
+    EXPECT_EQ(tokenizer::find_self_loop_end(self_loop, input, offset),
+              tokenizer::find_self_loop_end_scalar(self_loop, input, offset));
+  }
+}
+
+TEST_F(FiniteAutomatonTest, ByteSetTransitionsMatchEveryMember) {
+  tokenizer::ByteSet digits;
+  digits.insert_range('0', '9');
+  EXPECT_EQ(digits.contains('5'), true);
+  EXPECT_EQ(digits.contains('a'), false);
+  EXPECT_EQ(digits.complement().contains('a'), true);
+  EXPECT_EQ(tokenizer::ByteSet().is_empty(), true);
+
+  tokenizer::NonDeterministicFiniteAutomaton digit_automaton(digits);
+  tokenizer::NonDeterministicFiniteAutomaton digit_automaton_star(digits);
+  digit_automaton_star.apply_star();
+  digit_automaton.merge_on_concatenation(digit_automaton_star);
+  auto number_automaton = digit_automaton.convert_to_dfa();
+
+  // Every digit leads to the same subset, so no state is built per byte.
+  EXPECT_EQ(number_automaton.get_number_of_states(), 3);
+  tokenizer::AutomatonCursor cursor(number_automaton);
+  cursor.move('4');
+  cursor.move('2');
+  EXPECT_EQ(cursor.has_accepted(), true);
+  cursor.move('x');
+  EXPECT_EQ(cursor.is_dead(), true);
+}
+
+TEST_F(FiniteAutomatonTest, ByteClassesSplitOverlappingSets) {
+  tokenizer::ByteSet letters;
+  letters.insert_range('a', 'z');
+  tokenizer::ByteSet hex_digits;
+  hex_digits.insert_range('0', '9');
+  hex_digits.insert_range('a', 'f');
+  tokenizer::ByteClasses byte_classes;
+
+  // Everything else, a-f, g-z and 0-9.
+  EXPECT_EQ(tokenizer::compute_byte_classes(
+      {letters, hex_digits, letters}, &byte_classes), 4);
+  EXPECT_EQ(byte_classes['a'], byte_classes['f']);
+  EXPECT_EQ(byte_classes['g'], byte_classes['z']);
+  EXPECT_NE(byte_classes['f'], byte_classes['g']);
+  EXPECT_NE(byte_classes['0'], byte_classes['a']);
+  EXPECT_EQ(byte_classes['\0'], 0);
+  EXPECT_EQ(byte_classes['\0'], byte_classes['~']);
+
+  // The fixture only tells a, b and c apart from each other and the rest.
+  EXPECT_EQ(automaton.get_number_of_classes(), 4);
+}
+
+TEST_F(FiniteAutomatonTest, FragmentsShareOneGraph) {
+  auto graph = std::make_shared<tokenizer::TransitionGraph>();
+  tokenizer::NonDeterministicFiniteAutomaton a_automaton(
+      graph, tokenizer::ByteSet('a'));
+  tokenizer::NonDeterministicFiniteAutomaton b_automaton(
+      graph, tokenizer::ByteSet('b'));
+  auto a_start_state = a_automaton.get_start_state();
+  a_automaton.merge_on_union(b_automaton);
+  a_automaton.apply_star();
+
+  // Two states per symbol, union and star, and none of them copied.
+  EXPECT_EQ(graph->get_number_of_states(), 8);
+  EXPECT_EQ(a_start_state, 0);
+  EXPECT_EQ(a_automaton.get_graph(), graph);
+
+  // An automaton of another graph is appended once.
+  tokenizer::NonDeterministicFiniteAutomaton c_automaton("c");
+  c_automaton.merge_on_concatenation(a_automaton);
+  EXPECT_EQ(c_automaton.get_graph()->get_number_of_states(), 10);
+  EXPECT_EQ(c_automaton.get_start_state(), 0);
+
+  auto dfa = c_automaton.convert_to_dfa();
+  tokenizer::AutomatonCursor cursor(dfa);
+  cursor.move("cabba");
+  EXPECT_EQ(cursor.has_accepted(), true);
+}
+
+TEST_F(FiniteAutomatonTest, LookaheadIsBounded) {
+  // c(a|b)* reads one byte past a match to see it end, and a failed match
+  // from the start state is counted like a state passed through.
+  EXPECT_EQ(automaton.get_max_lookahead(), 2);
+
+  // After matching a, abc|a reads b and the byte after it.
+  tokenizer::NonDeterministicFiniteAutomaton abc_automaton("a");
+  abc_automaton.merge_on_concatenation(
+      tokenizer::NonDeterministicFiniteAutomaton("b"));
+  abc_automaton.merge_on_concatenation(
+      tokenizer::NonDeterministicFiniteAutomaton("c"));
+  tokenizer::NonDeterministicFiniteAutomaton abc_or_a_automaton(
+      {abc_automaton, tokenizer::NonDeterministicFiniteAutomaton("a")});
+  EXPECT_EQ(abc_or_a_automaton.convert_to_dfa().get_max_lookahead(), 2);
+
+  // After matching a, a*b|a reads as many a as there are.
+  tokenizer::NonDeterministicFiniteAutomaton a_star_b_automaton("a");
+  a_star_b_automaton.apply_star();
+  a_star_b_automaton.merge_on_concatenation(
+      tokenizer::NonDeterministicFiniteAutomaton("b"));
+  tokenizer::NonDeterministicFiniteAutomaton a_star_b_or_a_automaton(
+      {a_star_b_automaton, tokenizer::NonDeterministicFiniteAutomaton("a")});
+  EXPECT_EQ(a_star_b_or_a_automaton.convert_to_dfa().get_max_lookahead(), -1);
 }
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tokenizer/keyword_table.h"
+
+namespace {
+
+constexpr std::array<std::pair<std::string_view, int>, 4> kStaticKeywords{{
+    {"if", 1}, {"else", 2}, {"while", 3}, {"return", 4}}};
+
+}  // namespace
+
+TEST(KeywordTableTest, FindsKeywords) {
+  tokenizer::KeywordTable keywords(
+      {{"if", 10}, {"else", 11}, {"while", 12}, {"for", 13}, {"let", 14},
+       {"fn", 15}, {"return", 16}});
+  EXPECT_EQ(keywords.is_empty(), false);
+  EXPECT_EQ(keywords.find("if"), 10);
+  EXPECT_EQ(keywords.find("while"), 12);
+  EXPECT_EQ(keywords.find("return"), 16);
+  EXPECT_EQ(keywords.find("fn"), 15);
+
+  // Prefixes, extensions and words longer than every keyword.
+  for (std::string_view word : {"i", "iff", "If", "els", "elsewhere", "",
+                                "returning", "x", "f"})
+    EXPECT_EQ(keywords.find(word), -1) << word;
+  EXPECT_EQ(keywords.get_keywords().size(), 7);
+  EXPECT_EQ(keywords.is_valid(), true);
+}
+
+TEST(KeywordTableTest, EmptyTableFindsNothing) {
+  tokenizer::KeywordTable keywords;
+  EXPECT_EQ(keywords.is_empty(), true);
+  EXPECT_EQ(keywords.is_valid(), true);
+  EXPECT_EQ(keywords.find("if"), -1);
+  EXPECT_EQ(keywords.find(""), -1);
+  tokenizer::KeywordTable no_keywords(
+      std::vector<std::pair<std::string, int>>{});
+  EXPECT_EQ(no_keywords.is_empty(), true);
+  EXPECT_EQ(no_keywords.find("if"), -1);
+}
+
+TEST(KeywordTableTest, ManyKeywordsHaveNoCollisions) {
+  std::vector<std::pair<std::string, int>> keyword_tags;
+  for (auto idx = 0; idx < 5000; ++idx)
+    keyword_tags.emplace_back("kw" + std::to_string(idx * 7919), idx);
+  keyword_tags.emplace_back(std::string(16, 'z'), 5000);
+  keyword_tags.emplace_back("\xCF\x80", 5001);
+  auto keyword_hash = tokenizer::build_keyword_hash(keyword_tags);
+  EXPECT_EQ(keyword_hash.is_valid, true);
+  // Twice as many slots as keywords, rounded up to a power of 2.
+  EXPECT_EQ(keyword_hash.slots.size(), 16384);
+
+  tokenizer::KeywordTable keywords(keyword_tags);
+  for (const auto& [keyword, tag] : keyword_tags)
+    EXPECT_EQ(keywords.find(keyword), tag) << keyword;
+  for (auto idx = 0; idx < 5000; ++idx)
+    EXPECT_EQ(keywords.find("kw" + std::to_string(idx * 7919 + 1)), -1);
+  EXPECT_EQ(keywords.find(std::string(15, 'z')), -1);
+  EXPECT_EQ(keywords.find(std::string(17, 'z')), -1);
+}
+
+TEST(KeywordTableTest, InvalidKeywordsAreLeftOut) {
+  std::vector<std::pair<std::string, int>> keyword_tags = {
+      {"let", 1}, {"", 2}, {"let", 3}, {std::string(17, 'a'), 4}, {"fn", 5}};
+  EXPECT_EQ(tokenizer::build_keyword_hash(keyword_tags).is_valid, false);
+
+  tokenizer::KeywordTable keywords(keyword_tags);
+  EXPECT_EQ(keywords.is_valid(), false);
+  EXPECT_EQ(keywords.find("let"), 1);
+  EXPECT_EQ(keywords.find("fn"), 5);
+  EXPECT_EQ(keywords.find(std::string(17, 'a')), -1);
+  auto found_keywords = keywords.get_keywords();
+  std::sort(std::begin(found_keywords), std::end(found_keywords));
+  std::vector<std::pair<std::string, int>> expected_keywords = {
+      {"fn", 5}, {"let", 1}};
+  EXPECT_EQ(found_keywords, expected_keywords);
+}
+
+TEST(KeywordTableTest, StaticTableMatchesRuntimeTable) {
+  static constexpr auto kStaticTable =
+      tokenizer::build_static_keyword_table<kStaticKeywords>();
+  static_assert(kStaticTable.is_valid);
+  static_assert(kStaticTable.slots.size() == 8);
+
+  auto keywords = kStaticTable.to_keyword_table();
+  tokenizer::KeywordTable runtime_keywords(
+      {{"if", 1}, {"else", 2}, {"while", 3}, {"return", 4}});
+  // Keys hash the same at compile time and at run time, so both tables
+  // place the keywords in the same slots.
+  EXPECT_EQ(keywords.get_keywords(), runtime_keywords.get_keywords());
+  for (const auto& [keyword, tag] : kStaticKeywords)
+    EXPECT_EQ(keywords.find(keyword), tag);
+  EXPECT_EQ(keywords.find("whilst"), -1);
+}
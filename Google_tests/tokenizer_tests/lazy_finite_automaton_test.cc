@@ -0,0 +1,123 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/finite_automaton.h"
+#include "tokenizer/lazy_finite_automaton.h"
+#include "tokenizer/regular_expression.h"
+
+namespace {
+
+tokenizer::NonDeterministicFiniteAutomaton build_alternatives(
+    const std::vector<std::string>& patterns) {
+  auto graph = std::make_shared<tokenizer::TransitionGraph>();
+  std::vector<tokenizer::NonDeterministicFiniteAutomaton> alternatives;
+  for (const auto& pattern : patterns)
+    alternatives.push_back(tokenizer::build_nfa(
+        tokenizer::parse_regular_expression(pattern), graph));
+  return tokenizer::NonDeterministicFiniteAutomaton(alternatives);
+}
+
+/**
+ * (a|b)*a(a|b)...(a|b) with n trailing (a|b): the n + 1st byte from the end
+ * is an 'a'. Its DFA has 2^(n + 1) states.
+ */
+std::string get_blow_up_pattern(int n) {
+  std::string pattern = "(a|b)*a";
+  for (auto idx = 0; idx < n; ++idx)
+    pattern += "(a|b)";
+  return pattern;
+}
+
+}  // namespace
+
+class LazyFiniteAutomatonTest : public ::testing::Test {
+ protected:
+  std::vector<std::string> patterns{
+      "[a-z][a-z0-9]*", "[0-9][0-9]*", "if", "==", "=", "\\s\\s*"};
+  std::string input = "if x1 == 42 iffy = if2";
+};
+
+TEST_F(LazyFiniteAutomatonTest, MatchesEagerAutomaton) {
+  auto eager_automaton = build_alternatives(patterns).convert_to_dfa();
+  tokenizer::LazyDeterministicFiniteAutomaton lazy_automaton(
+      build_alternatives(patterns));
+  EXPECT_EQ(lazy_automaton.get_number_of_classes(),
+            eager_automaton.get_number_of_classes());
+
+  for (std::size_t offset = 0; offset < input.size(); ++offset) {
+    int eager_tag;
+    int lazy_tag;
+    EXPECT_EQ(lazy_automaton.find_longest_match(input, offset, &lazy_tag),
+              eager_automaton.find_longest_match(input, offset, &eager_tag));
+    EXPECT_EQ(lazy_tag, eager_tag);
+  }
+  EXPECT_LE(lazy_automaton.get_number_of_cached_states(),
+            eager_automaton.get_number_of_states());
+  EXPECT_EQ(lazy_automaton.get_number_of_cache_flushes(), 0);
+
+  lazy_automaton.move('i');
+  lazy_automaton.move('f');
+  EXPECT_TRUE(lazy_automaton.has_accepted());
+  EXPECT_EQ(lazy_automaton.get_final_state_tag(), 0);
+  lazy_automaton.move('=');
+  EXPECT_TRUE(lazy_automaton.is_dead());
+  lazy_automaton.reset();
+  lazy_automaton.move('=');
+  lazy_automaton.move('=');
+  EXPECT_EQ(lazy_automaton.get_final_state_tag(), 3);
+}
+
+TEST_F(LazyFiniteAutomatonTest, CacheStaysBounded) {
+  constexpr int kTrailingSymbols = 16;
+  constexpr std::size_t kCacheCapacity = 1 << 16;
+  tokenizer::LazyDeterministicFiniteAutomaton lazy_automaton(
+      tokenizer::build_nfa(
+          tokenizer::parse_regular_expression(
+              get_blow_up_pattern(kTrailingSymbols)),
+          std::make_shared<tokenizer::TransitionGraph>()),
+      kCacheCapacity);
+
+  std::string long_input;
+  std::uint32_t random_state = 12345;
+  for (auto idx = 0; idx < 50000; ++idx) {
+    random_state = random_state * 1664525 + 1013904223;
+    long_input += (random_state >> 16) & 1 ? 'a' : 'b';
+  }
+  std::size_t expected_match_length = 0;
+  for (std::size_t end = kTrailingSymbols + 1; end <= long_input.size();
+       ++end) {
+    if (long_input[end - kTrailingSymbols - 1] == 'a')
+      expected_match_length = end;
+  }
+
+  int tag;
+  EXPECT_EQ(lazy_automaton.find_longest_match(long_input, 0, &tag),
+            expected_match_length);
+  EXPECT_EQ(tag, 0);
+  EXPECT_GT(lazy_automaton.get_number_of_cache_flushes(), 0);
+  EXPECT_LE(lazy_automaton.get_cache_size(), kCacheCapacity);
+}
+
+TEST_F(LazyFiniteAutomatonTest, TinyCacheStillMoves) {
+  auto eager_automaton = build_alternatives(patterns).convert_to_dfa();
+  tokenizer::LazyDeterministicFiniteAutomaton lazy_automaton(
+      build_alternatives(patterns), 0);
+
+  lazy_automaton.move('i');
+  for (std::size_t offset = 0; offset < input.size(); ++offset) {
+    int eager_tag;
+    int lazy_tag;
+    EXPECT_EQ(lazy_automaton.find_longest_match(input, offset, &lazy_tag),
+              eager_automaton.find_longest_match(input, offset, &eager_tag));
+    EXPECT_EQ(lazy_tag, eager_tag);
+  }
+  EXPECT_GT(lazy_automaton.get_number_of_cache_flushes(), 0);
+
+  // The state move() was in survives the flushes.
+  lazy_automaton.move('f');
+  EXPECT_EQ(lazy_automaton.get_final_state_tag(), 0);
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tokenizer/line_index.h"
+#include "tokenizer/tokenizer.h"
+
+class LineIndexTest : public ::testing::Test {
+ protected:
+  std::string source = "x=1\n\nabc+22\ny";
+};
+
+TEST_F(LineIndexTest, LocationsOfOffsets) {
+  tokenizer::LineIndex line_index(source);
+  EXPECT_EQ(line_index.is_built(), false);
+
+  auto location = line_index.get_location(0);
+  EXPECT_EQ(location.line, 1);
+  EXPECT_EQ(location.column, 1);
+  EXPECT_EQ(line_index.is_built(), true);
+
+  // The newline itself ends its line.
+  location = line_index.get_location(3);
+  EXPECT_EQ(location.line, 1);
+  EXPECT_EQ(location.column, 4);
+  location = line_index.get_location(4);
+  EXPECT_EQ(location.line, 2);
+  EXPECT_EQ(location.column, 1);
+  location = line_index.get_location(9);
+  EXPECT_EQ(location.line, 3);
+  EXPECT_EQ(location.column, 5);
+  location = line_index.get_location(source.size());
+  EXPECT_EQ(location.line, 4);
+  EXPECT_EQ(location.column, 2);
+
+  EXPECT_EQ(line_index.get_number_of_lines(), 4);
+  EXPECT_EQ(line_index.get_line(1), "x=1");
+  EXPECT_EQ(line_index.get_line(2), "");
+  EXPECT_EQ(line_index.get_line(3), "abc+22");
+  EXPECT_EQ(line_index.get_line(4), "y");
+}
+
+TEST_F(LineIndexTest, EmptySourceHasOneLine) {
+  tokenizer::LineIndex line_index("");
+  EXPECT_EQ(line_index.get_number_of_lines(), 1);
+  EXPECT_EQ(line_index.get_location(0).column, 1);
+  EXPECT_EQ(line_index.get_line(1), "");
+}
+
+TEST_F(LineIndexTest, OutOfRangeLookupsAreClamped) {
+  tokenizer::LineIndex line_index(source);
+  // Offsets past the end are at the end of the source.
+  auto location = line_index.get_location(source.size() + 100);
+  EXPECT_EQ(location.line, 4);
+  EXPECT_EQ(location.column, 2);
+  EXPECT_EQ(line_index.get_line(0), "");
+  EXPECT_EQ(line_index.get_line(5), "");
+  EXPECT_EQ(line_index.get_line(1000), "");
+}
+
+TEST_F(LineIndexTest, LocatesTokens) {
+  tokenizer::Tokenizer tokenizer_for_lang;
+  auto tokens = tokenizer_for_lang.tokenize_all("x=1\n");
+  tokenizer::LineIndex line_index(tokens.get_source());
+
+  // The lexer stops at the newline with an invalid token.
+  auto last_token_idx = tokens.size() - 1;
+  EXPECT_EQ(tokens.get_token_type(last_token_idx),
+            tokenizer::TokenType::invalid);
+  auto location = line_index.get_location(tokens.get_offset(last_token_idx));
+  EXPECT_EQ(location.line, 1);
+  EXPECT_EQ(location.column, 4);
+}
+
+TEST_F(LineIndexTest, LineStartsMatchScalarSearch) {
+  std::string long_source;
+  unsigned int seed = 1;
+  for (auto idx = 0; idx < 4096; ++idx) {
+    seed = seed * 1103515245 + 12345;
+    // Runs of newlines and lines longer than a vector.
+    long_source += (seed >> 16) % 5 == 0 ? '\n'
+                                        : static_cast<char>(seed >> 8);
+    if (idx % 1000 == 0)
+      long_source += std::string(100, 'a');
+  }
+
+  for (std::size_t size = 0; size <= 100; ++size) {
+    std::vector<std::uint32_t> line_starts;
+    std::vector<std::uint32_t> expected_line_starts;
+    auto prefix = std::string_view(long_source).substr(0, size);
+    tokenizer::find_line_starts(prefix, &line_starts);
+    tokenizer::find_line_starts_scalar(prefix, &expected_line_starts);
+    EXPECT_EQ(line_starts, expected_line_starts);
+  }
+  std::vector<std::uint32_t> line_starts;
+  std::vector<std::uint32_t> expected_line_starts;
+  tokenizer::find_line_starts(long_source, &line_starts);
+  tokenizer::find_line_starts_scalar(long_source, &expected_line_starts);
+  EXPECT_EQ(line_starts, expected_line_starts);
+}
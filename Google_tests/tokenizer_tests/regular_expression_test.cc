@@ -1,5 +1,9 @@
 #include "gtest/gtest.h"
 
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "tokenizer/regular_expression.h"
 
 class RegularExpressionTest : public ::testing::Test {
@@ -66,3 +70,276 @@ TEST_F(RegularExpressionTest, TestUnionConcantenationAndStar) {
   EXPECT_EQ(regex7.match("amfs"), "a");
   EXPECT_EQ(regex7.match("dfsadf"), "");
 }
+
+TEST_F(RegularExpressionTest, TestMinimizedStateCounts) {
+  EXPECT_EQ(regex5.get_number_of_unminimized_states(), 7);
+  EXPECT_EQ(regex5.get_number_of_states(), 5);
+  EXPECT_EQ(regex7.get_number_of_unminimized_states(), 5);
+  EXPECT_EQ(regex7.get_number_of_states(), 2);
+}
+
+TEST_F(RegularExpressionTest, TestCharacterClasses) {
+  tokenizer::RegularExpression identifier_regex("[a-z_][a-z0-9_]*");
+  EXPECT_EQ(identifier_regex.match("snake_case2+x"), "snake_case2");
+  EXPECT_EQ(identifier_regex.match("2x"), "");
+  EXPECT_EQ(identifier_regex.get_number_of_states(), 2);
+
+  tokenizer::RegularExpression negated_regex("[^0-9]*");
+  EXPECT_EQ(negated_regex.match("ab(c)9"), "ab(c)");
+
+  tokenizer::RegularExpression literal_regex("[]-][-a]");
+  EXPECT_EQ(literal_regex.match("]a"), "]a");
+  EXPECT_EQ(literal_regex.match("--"), "--");
+  EXPECT_EQ(literal_regex.match("]b"), "");
+}
+
+TEST_F(RegularExpressionTest, TestEscapes) {
+  tokenizer::RegularExpression number_regex("\\d\\d*");
+  EXPECT_EQ(number_regex.match("1234abc"), "1234");
+
+  tokenizer::RegularExpression parenthesis_regex("\\((a|\\|)\\)");
+  EXPECT_EQ(parenthesis_regex.match("(|)"), "(|)");
+  EXPECT_EQ(parenthesis_regex.match("(a)"), "(a)");
+
+  tokenizer::RegularExpression space_regex("[\\s\\]]*");
+  EXPECT_EQ(space_regex.match(" \t]\nx"), " \t]\n");
+}
+
+TEST_F(RegularExpressionTest, TestSyntaxTree) {
+  using tokenizer::RegularExpressionNodeType;
+  // Concatenation binds tighter than alternation, and star tighter still.
+  auto tree = tokenizer::parse_regular_expression("ab|c*");
+  ASSERT_EQ(tree.size(), 6);
+  EXPECT_EQ(tree[2].node_type, RegularExpressionNodeType::concat);
+  EXPECT_EQ(tree[4].node_type, RegularExpressionNodeType::star);
+  EXPECT_EQ(tree[5].node_type, RegularExpressionNodeType::unio);
+  EXPECT_EQ(tree[5].first_operand, 2);
+  EXPECT_EQ(tree[5].second_operand, 4);
+
+  tokenizer::RegularExpression grouped_regex("ab|cd");
+  EXPECT_EQ(grouped_regex.match("abd"), "ab");
+  EXPECT_EQ(grouped_regex.match("cd"), "cd");
+  EXPECT_EQ(grouped_regex.match("ad"), "");
+
+  tokenizer::RegularExpression empty_alternative_regex("a(b|)c");
+  EXPECT_EQ(empty_alternative_regex.match("abc"), "abc");
+  EXPECT_EQ(empty_alternative_regex.match("ac"), "ac");
+
+  // Operators with nothing to apply to are literals.
+  EXPECT_EQ(tokenizer::RegularExpression("*").match("*"), "*");
+  EXPECT_EQ(tokenizer::RegularExpression("a)").match("a)"), "a)");
+}
+
+TEST_F(RegularExpressionTest, TestLongExpressions) {
+  std::string long_expression;
+  for (auto idx = 0; idx < 20000; ++idx)
+    long_expression += "(a|b)c*";
+  auto tree = tokenizer::parse_regular_expression(long_expression);
+  EXPECT_EQ(tree.size(), 20000 * 7 - 1);
+  EXPECT_EQ(tree.back().node_type, tokenizer::RegularExpressionNodeType::concat);
+
+  std::string expression;
+  std::string input;
+  for (auto idx = 0; idx < 500; ++idx) {
+    expression += "(a|b)c*";
+    input += idx % 2 == 0 ? "accc" : "b";
+  }
+  tokenizer::RegularExpression regex(expression);
+  EXPECT_EQ(regex.match(input + "a"), input);
+  EXPECT_EQ(regex.match(input.substr(1)), "");
+}
+
+TEST_F(RegularExpressionTest, TestMatchLength) {
+  const tokenizer::RegularExpression& const_regex7 = regex7;
+  EXPECT_EQ(const_regex7.match_length("acdcx", 0), 4);
+  EXPECT_EQ(const_regex7.match_length("xxbdd", 2), 3);
+  EXPECT_EQ(const_regex7.match_length("xxbdd", 1), 0);
+  EXPECT_EQ(const_regex7.match_length("ab", 2), 0);
+  EXPECT_EQ(const_regex7.match("acdcx"), "acdc");
+
+  std::vector<std::string_view> inputs{"ad", "", "bcx", "x", "a"};
+  std::vector<std::size_t> match_lengths(inputs.size());
+  const_regex7.match_lengths(inputs, match_lengths);
+  EXPECT_EQ(match_lengths, (std::vector<std::size_t>{2, 0, 2, 0, 1}));
+}
+
+TEST_F(RegularExpressionTest, TestUtf8Literals) {
+  // A multibyte character is one atom, so the star repeats all of it.
+  tokenizer::RegularExpression literal_regex("caf\xC3\xA9*");
+  EXPECT_EQ(literal_regex.match("caf\xC3\xA9\xC3\xA9!"), "caf\xC3\xA9\xC3\xA9");
+  EXPECT_EQ(literal_regex.match("caf\xC3\xA9\xA9"), "caf\xC3\xA9");
+
+  tokenizer::RegularExpression escape_regex("\\u{20ac}\\u{1F600}");
+  EXPECT_EQ(escape_regex.match("\xE2\x82\xAC\xF0\x9F\x98\x80x"),
+            "\xE2\x82\xAC\xF0\x9F\x98\x80");
+  EXPECT_EQ(escape_regex.match("\xE2\x82\xAC"), "");
+
+  // Escapes of surrogates or of code points past U+10FFFF match nothing.
+  EXPECT_EQ(tokenizer::RegularExpression("a\\u{d800}").match("a\xED\xA0\x80"),
+            "");
+  EXPECT_EQ(tokenizer::RegularExpression("\\u").match("u"), "u");
+}
+
+TEST_F(RegularExpressionTest, TestUnicodeClasses) {
+  tokenizer::RegularExpression greek_regex("[\xCE\xB1-\xCF\x89_]*");
+  EXPECT_EQ(greek_regex.match("\xCE\xB1\xCE\xB2_\xCF\x89\xCE\x91"),
+            "\xCE\xB1\xCE\xB2_\xCF\x89");
+
+  tokenizer::RegularExpression identifier_regex(
+      "[a-z\\u{80}-\\u{10ffff}][a-z0-9\\u{80}-\\u{10ffff}]*");
+  EXPECT_EQ(identifier_regex.match("na\xC3\xAFve2 x"), "na\xC3\xAFve2");
+  EXPECT_EQ(identifier_regex.match("\xE5\x90\x8D\xF0\x9F\x98\x80+"),
+            "\xE5\x90\x8D\xF0\x9F\x98\x80");
+  // Bytes that are not valid UTF-8 end the match.
+  EXPECT_EQ(identifier_regex.match("ab\xC3(x"), "ab");
+  EXPECT_EQ(identifier_regex.match("ab\xED\xA0\x80"), "ab");
+  EXPECT_EQ(identifier_regex.match("ab\xC0\xAF"), "ab");
+
+  // A class of code points is negated over code points, and a class of
+  // bytes over bytes.
+  tokenizer::RegularExpression not_greek_regex("[^\xCE\xB1-\xCF\x89]*");
+  EXPECT_EQ(not_greek_regex.match("ab\xC3\xA9\xCE\xB1"), "ab\xC3\xA9");
+  EXPECT_EQ(not_greek_regex.match("ab\xFF"), "ab");
+  tokenizer::RegularExpression not_quote_regex("[^\"]*");
+  EXPECT_EQ(not_quote_regex.match("a\xFF\""), "a\xFF");
+}
+
+TEST_F(RegularExpressionTest, TestRequiredLiterals) {
+  auto get_required_literal = [](const std::string& expression) {
+    return tokenizer::RegularExpression(expression).get_required_literal();
+  };
+  EXPECT_EQ(get_required_literal("abc").literal, "abc");
+  EXPECT_EQ(get_required_literal("ab*c").literal, "a");
+
+  auto required_literal = get_required_literal("[xy]abz*");
+  EXPECT_EQ(required_literal.literal, "ab");
+  EXPECT_EQ(required_literal.offset, 1);
+  // After a part of varying length, the offset of a literal is unknown.
+  required_literal = get_required_literal("a*bcd");
+  EXPECT_EQ(required_literal.literal, "");
+  required_literal = get_required_literal("x[0-9]*value");
+  EXPECT_EQ(required_literal.literal, "x");
+
+  required_literal = get_required_literal("(prefix|pre)[0-9]");
+  EXPECT_EQ(required_literal.literal, "pre");
+  EXPECT_EQ(get_required_literal("(ab|cd)").literal, "");
+  required_literal = get_required_literal("(a|b)(cd|ce)f");
+  EXPECT_EQ(required_literal.literal, "c");
+  EXPECT_EQ(required_literal.offset, 1);
+
+  // A multibyte character is a literal of its UTF-8 bytes.
+  EXPECT_EQ(get_required_literal("\\u{e9}t\xC3\xA9").literal,
+            "\xC3\xA9t\xC3\xA9");
+}
+
+TEST_F(RegularExpressionTest, TestFindAll) {
+  tokenizer::RegularExpression number_regex("\\d\\d*");
+  auto matches = number_regex.find_all("ab12 3x456");
+  std::vector<tokenizer::RegularExpressionMatch> expected_matches = {
+      {2, 2}, {5, 1}, {7, 3}};
+  EXPECT_EQ(matches, expected_matches);
+
+  // Matches do not overlap, and empty matches are left out.
+  tokenizer::RegularExpression pair_regex("aa");
+  expected_matches = {{0, 2}, {2, 2}, {5, 2}};
+  EXPECT_EQ(pair_regex.find_all("aaaaxaaa"), expected_matches);
+  EXPECT_EQ(tokenizer::RegularExpression("b*").find_all("abba"),
+            (std::vector<tokenizer::RegularExpressionMatch>{{1, 2}}));
+  EXPECT_EQ(tokenizer::RegularExpression().find_all("abc").size(), 0);
+  EXPECT_EQ(number_regex.find_all("").size(), 0);
+}
+
+TEST_F(RegularExpressionTest, TestFindAllMatchesNaiveSearch) {
+  std::string haystack;
+  for (auto idx = 0; idx < 3000; ++idx)
+    haystack += "abcxyz 019 prefix7 pre= value=42;"[idx * 7919 % 33];
+  haystack += "value=9 prefix";
+
+  for (std::string expression :
+       {"value=[0-9]*", "[xy]abz*", "(prefix|pre)[0-9]", "[a-c][a-c]*",
+        "x[0-9]*value", "a*bcd", "(a|b)(cd|ce)f", "e", "[^a-z]", "z*y"}) {
+    tokenizer::RegularExpression regex(expression);
+    std::vector<tokenizer::RegularExpressionMatch> expected_matches;
+    for (std::size_t idx = 0; idx < haystack.size();) {
+      auto length = regex.match_length(haystack, idx);
+      if (length != 0)
+        expected_matches.push_back({idx, length});
+      idx += length != 0 ? length : 1;
+    }
+    EXPECT_EQ(regex.find_all(haystack), expected_matches) << expression;
+  }
+}
+
+TEST_F(RegularExpressionTest, TestLazyModeMatchesEagerMode) {
+  std::string haystack;
+  for (auto idx = 0; idx < 3000; ++idx)
+    haystack += "abcxyz 019 prefix7 pre= value=42;"[idx * 7919 % 33];
+
+  for (std::string expression :
+       {"value=[0-9]*", "[xy]abz*", "(prefix|pre)[0-9]", "z*y",
+        "(a|b)*a(a|b)(a|b)(a|b)", ""}) {
+    tokenizer::RegularExpression eager_regex(expression);
+    tokenizer::RegularExpression lazy_regex(
+        expression, tokenizer::AutomatonMode::lazy);
+    EXPECT_EQ(lazy_regex.find_all(haystack), eager_regex.find_all(haystack))
+        << expression;
+    for (std::size_t idx = 0; idx < 100; ++idx)
+      EXPECT_EQ(lazy_regex.match_length(haystack, idx),
+                eager_regex.match_length(haystack, idx)) << expression;
+  }
+}
+
+TEST_F(RegularExpressionTest, TestLazyModeBoundsStates) {
+  // The 21st byte from the end is an 'a'. The eager automaton would have
+  // 2^21 states.
+  std::string expression = "(a|b)*a";
+  for (auto idx = 0; idx < 20; ++idx)
+    expression += "(a|b)";
+  tokenizer::RegularExpression regex(
+      expression, tokenizer::AutomatonMode::lazy, 1 << 16);
+
+  std::string input = "b" + std::string(20, 'b');
+  EXPECT_EQ(regex.match_length(input, 0), 0);
+  input[0] = 'a';
+  EXPECT_EQ(regex.match_length(input, 0), 21);
+  std::string haystack;
+  for (auto idx = 0; idx < 5000; ++idx)
+    haystack += "ab"[idx * 7919 % 13 < 6];
+  auto matches = regex.find_all(haystack);
+  EXPECT_EQ(matches.empty(), false);
+  for (const auto& match : matches)
+    EXPECT_EQ(haystack[match.offset + match.length - 21], 'a');
+  // A cached state takes far more than 32 bytes.
+  EXPECT_LE(regex.get_number_of_states(), (1 << 16) / 32);
+}
+
+TEST_F(RegularExpressionTest, TestLazyCopiesHaveTheirOwnCache) {
+  tokenizer::RegularExpression regex(
+      "(a|b)*a(a|b)(a|b)(a|b)(a|b)", tokenizer::AutomatonMode::lazy);
+  std::string haystack;
+  for (auto idx = 0; idx < 20000; ++idx)
+    haystack += "ab"[idx * 7919 % 13 < 6];
+  auto expected_matches = regex.find_all(haystack);
+  auto number_of_states = regex.get_number_of_states();
+
+  // Each thread matches with its own copy, so neither touches the cache
+  // of the other or of regex.
+  std::vector<tokenizer::RegularExpression> copies(2, regex);
+  std::vector<std::vector<tokenizer::RegularExpressionMatch>> matches(2);
+  std::vector<std::thread> threads;
+  for (auto idx = 0; idx < 2; ++idx) {
+    threads.emplace_back([&, idx] {
+      EXPECT_LT(copies[idx].get_number_of_states(), number_of_states);
+      matches[idx] = copies[idx].find_all(haystack);
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(matches[0], expected_matches);
+  EXPECT_EQ(matches[1], expected_matches);
+  EXPECT_EQ(regex.get_number_of_states(), number_of_states);
+
+  tokenizer::RegularExpression assigned_regex;
+  assigned_regex = copies[0];
+  EXPECT_EQ(assigned_regex.find_all(haystack), expected_matches);
+}
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "built_in_scanner.h"
+#include "tokenizer/scanner_generator.h"
+#include "tokenizer/tokenizer.h"
+
+class ScannerGeneratorTest : public ::testing::Test {
+ protected:
+  tokenizer::Tokenizer tokenizer_for_lang;
+};
+
+TEST_F(ScannerGeneratorTest, GeneratedTokensMatchTokenizer) {
+  std::vector<std::string> inputs{
+      "", "x", "(adf2123==3123)*x-99/(y=z)", "a===b", "12ab+?3", "=", "?",
+      "if(iffy)return(x)else(fn)*while2+while"};
+  std::string long_input;
+  unsigned int seed = 1;
+  const std::string alphabet = "az09+-*/=()?";
+  for (auto idx = 0; idx < 20000; ++idx) {
+    seed = seed * 1103515245 + 12345;
+    // Mostly valid bytes, so the invalid ones end the input late.
+    auto symbol_idx = (seed >> 16) % (alphabet.size() * 100);
+    long_input += symbol_idx < 100 * (alphabet.size() - 1)
+        ? alphabet[symbol_idx % (alphabet.size() - 1)]
+        : alphabet.back();
+  }
+  inputs.push_back(long_input);
+
+  for (const auto& input : inputs) {
+    auto tokens = built_in_scanner::tokenize_all(input);
+    auto expected_tokens = tokenizer_for_lang.tokenize_all(input);
+    EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+    EXPECT_EQ(tokens.get_offsets(), expected_tokens.get_offsets());
+    EXPECT_EQ(tokens.get_lengths(), expected_tokens.get_lengths());
+  }
+}
+
+TEST_F(ScannerGeneratorTest, GeneratedMatchesAreLongest) {
+  const auto& automaton = tokenizer_for_lang.get_program()->get_automaton();
+  std::string input = "ab12==(==x";
+  for (std::size_t offset = 0; offset <= input.size(); ++offset) {
+    int tag;
+    int expected_tag;
+    EXPECT_EQ(built_in_scanner::find_longest_match(input, offset, &tag),
+              automaton.find_longest_match(input, offset, &expected_tag));
+    EXPECT_EQ(tag, expected_tag);
+  }
+}
+
+TEST_F(ScannerGeneratorTest, StatesBecomeLabeledBlocks) {
+  tokenizer::LexerProgram program({
+      {"ab*", tokenizer::TokenType::id},
+      {"c", tokenizer::TokenType::plus}});
+  auto source = tokenizer::generate_scanner_source(program, "abc_scanner");
+
+  EXPECT_NE(source.find("namespace abc_scanner {"), std::string::npos);
+  EXPECT_NE(source.find("#include \"abc_scanner.h\""), std::string::npos);
+  EXPECT_NE(source.find("case 'a':"), std::string::npos);
+  EXPECT_NE(source.find("case 'b':"), std::string::npos);
+  EXPECT_NE(source.find("tag = 1;"), std::string::npos);
+  EXPECT_EQ(source.find("_moves:"), std::string::npos);
+  // The start state, the state after a or b, and the state after c.
+  EXPECT_EQ(program.get_automaton().get_number_of_states(), 3);
+  EXPECT_NE(source.find("static_cast<tokenizer::TokenType>(2)"),
+            std::string::npos);
+
+  // A start state that is entered again on a byte records its match there,
+  // but not when the scanner starts in it.
+  tokenizer::LexerProgram star_program({{"a*", tokenizer::TokenType::id}});
+  auto star_source =
+      tokenizer::generate_scanner_source(star_program, "star_scanner");
+  EXPECT_NE(star_source.find("goto state_0_moves;"), std::string::npos);
+  EXPECT_NE(star_source.find("state_0_moves:"), std::string::npos);
+
+  auto header = tokenizer::generate_scanner_header("abc_scanner");
+  EXPECT_NE(header.find("#ifndef ABC_SCANNER_H_"), std::string::npos);
+}
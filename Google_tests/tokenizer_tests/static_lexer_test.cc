@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tokenizer/static_lexer.h"
+#include "tokenizer/tokenizer.h"
+
+namespace {
+
+constexpr std::array<std::pair<std::string_view, int>, 3> kTokenDefinitions =
+    {{{"\\d\\d*", 0}, {"[a-z_]\\w*", 1}, {"(\\(|\\))", 2}}};
+
+constexpr auto kAutomaton =
+    tokenizer::build_static_automaton<kTokenDefinitions>();
+
+constexpr auto kBuiltInAutomaton = tokenizer::build_static_automaton<
+    tokenizer::Tokenizer::kBuiltInTokenDefinitions>();
+
+}  // namespace
+
+// Sizes are known to the compiler.
+static_assert(decltype(kBuiltInAutomaton)::kNumberOfStates == 18);
+static_assert(decltype(kBuiltInAutomaton)::kNumberOfClasses == 21);
+static_assert(kBuiltInAutomaton.byte_classes['a'] ==
+              kBuiltInAutomaton.byte_classes['z']);
+
+class StaticLexerTest : public ::testing::Test {};
+
+TEST_F(StaticLexerTest, MatchesTheLongestPrefix) {
+  auto automaton = kAutomaton.to_automaton();
+  int final_state_tag;
+
+  EXPECT_EQ(automaton.find_longest_match("1234ab", 0, &final_state_tag), 4);
+  EXPECT_EQ(final_state_tag, 0);
+  EXPECT_EQ(automaton.find_longest_match("snake_Case9+", 0, &final_state_tag),
+            11);
+  EXPECT_EQ(final_state_tag, 1);
+  EXPECT_EQ(automaton.find_longest_match("(a)", 0, &final_state_tag), 1);
+  EXPECT_EQ(final_state_tag, 2);
+  EXPECT_EQ(automaton.find_longest_match("+", 0, &final_state_tag), 0);
+  EXPECT_EQ(final_state_tag, -1);
+}
+
+TEST_F(StaticLexerTest, MatchesRunTimeAutomaton) {
+  std::vector<std::pair<std::string, tokenizer::TokenType>> token_definitions;
+  for (const auto& token_definition :
+       tokenizer::Tokenizer::kBuiltInTokenDefinitions)
+    token_definitions.emplace_back(token_definition);
+  tokenizer::Tokenizer run_time_tokenizer(token_definitions);
+  tokenizer::Tokenizer compile_time_tokenizer;
+
+  EXPECT_EQ(run_time_tokenizer.get_number_of_states(),
+            kBuiltInAutomaton.kNumberOfStates);
+  EXPECT_EQ(run_time_tokenizer.get_number_of_unminimized_states(),
+            kBuiltInAutomaton.number_of_unminimized_states);
+
+  std::string input = "(abc12+3456)*x-(98/y7)==value=42+(a==";
+  auto run_time_tokens = run_time_tokenizer.tokenize_all(input);
+  auto compile_time_tokens = compile_time_tokenizer.tokenize_all(input);
+  EXPECT_EQ(compile_time_tokens.get_token_types(),
+            run_time_tokens.get_token_types());
+  EXPECT_EQ(compile_time_tokens.get_lengths(), run_time_tokens.get_lengths());
+}
+
+TEST_F(StaticLexerTest, HasTheTablesOfTheRunTimeAutomaton) {
+  std::vector<std::pair<std::string, tokenizer::TokenType>> token_definitions;
+  for (const auto& token_definition :
+       tokenizer::Tokenizer::kBuiltInTokenDefinitions)
+    token_definitions.emplace_back(token_definition);
+  tokenizer::LexerProgram program(token_definitions);
+  const auto& run_time_automaton = program.get_automaton();
+  auto compile_time_automaton = kBuiltInAutomaton.to_automaton();
+
+  // Both are built by the same subset construction and minimization, so
+  // they agree state for state, not only on the tokens they find.
+  EXPECT_EQ(compile_time_automaton.get_start_state(),
+            run_time_automaton.get_start_state());
+  EXPECT_EQ(compile_time_automaton.get_number_of_classes(),
+            run_time_automaton.get_number_of_classes());
+  auto as_vector = [](auto span) {
+    return std::vector(std::begin(span), std::end(span));
+  };
+  EXPECT_EQ(as_vector(compile_time_automaton.get_byte_classes()),
+            as_vector(run_time_automaton.get_byte_classes()));
+  EXPECT_EQ(as_vector(compile_time_automaton.get_transition_table()),
+            as_vector(run_time_automaton.get_transition_table()));
+  EXPECT_EQ(as_vector(compile_time_automaton.get_final_state_tags()),
+            as_vector(run_time_automaton.get_final_state_tags()));
+}
@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tokenizer/symbol_table.h"
+
+class SymbolTableTest : public ::testing::Test {
+ protected:
+  tokenizer::SymbolTable symbol_table;
+};
+
+TEST_F(SymbolTableTest, InternsDenseSymbols) {
+  EXPECT_EQ(symbol_table.intern("x"), 0);
+  EXPECT_EQ(symbol_table.intern("value"), 1);
+  EXPECT_EQ(symbol_table.intern("x"), 0);
+  EXPECT_EQ(symbol_table.intern(""), 2);
+  EXPECT_EQ(symbol_table.size(), 3);
+  EXPECT_EQ(symbol_table.get_name(1), "value");
+
+  EXPECT_EQ(symbol_table.find("value"), 1);
+  EXPECT_EQ(symbol_table.find("y"), tokenizer::SymbolTable::kNoSymbol);
+  EXPECT_EQ(symbol_table.size(), 3);
+}
+
+TEST_F(SymbolTableTest, InternsEmptyNameFirst) {
+  // Nothing is stored yet when the empty name comes in.
+  EXPECT_EQ(symbol_table.intern(""), 0);
+  EXPECT_EQ(symbol_table.intern(""), 0);
+  EXPECT_EQ(symbol_table.get_name(0), "");
+  EXPECT_EQ(symbol_table.intern("x"), 1);
+  EXPECT_EQ(symbol_table.find(""), 0);
+  EXPECT_EQ(symbol_table.size(), 2);
+}
+
+TEST_F(SymbolTableTest, NamesSurviveGrowth) {
+  // Names are interned from a temporary, so the table has to own them.
+  std::vector<std::string_view> names;
+  for (auto idx = 0; idx < 10000; ++idx)
+    names.push_back(symbol_table.get_name(
+        symbol_table.intern("name" + std::to_string(idx))));
+  std::string long_name(100000, 'a');
+  auto long_symbol = symbol_table.intern(long_name);
+
+  auto moved_symbol_table = std::move(symbol_table);
+  EXPECT_EQ(moved_symbol_table.size(), 10001);
+  for (auto idx = 0; idx < 10000; ++idx) {
+    auto name = "name" + std::to_string(idx);
+    EXPECT_EQ(names[idx], name);
+    EXPECT_EQ(moved_symbol_table.find(name), idx);
+  }
+  EXPECT_EQ(moved_symbol_table.get_name(long_symbol), long_name);
+  EXPECT_EQ(moved_symbol_table.intern("name9999"), 9999);
+}
+
+TEST_F(SymbolTableTest, NamesWithACommonPrefixSpreadOut) {
+  // Names differing only after their first 5 bytes, like identifiers with
+  // a common stem, against the same suffixes put first.
+  auto get_names = [](bool is_prefix) {
+    std::vector<std::string> names;
+    for (auto first = 'a'; first <= 'z'; ++first) {
+      for (auto second = 'a'; second <= 'z'; ++second) {
+        for (auto third = 'a'; third <= 'z'; ++third) {
+          std::string suffix{first, second, third};
+          names.push_back(is_prefix ? "value" + suffix : suffix + "value");
+        }
+      }
+    }
+    return names;
+  };
+  auto intern_names = [](const std::vector<std::string>& names) {
+    auto fastest_time = std::chrono::steady_clock::duration::max();
+    for (auto repetition = 0; repetition < 3; ++repetition) {
+      tokenizer::SymbolTable symbol_table;
+      auto start_time = std::chrono::steady_clock::now();
+      for (std::uint32_t symbol = 0; symbol < names.size(); ++symbol)
+        EXPECT_EQ(symbol_table.intern(names[symbol]), symbol);
+      fastest_time = std::min(
+          fastest_time, std::chrono::steady_clock::now() - start_time);
+      for (std::uint32_t symbol = 0; symbol < names.size(); ++symbol)
+        EXPECT_EQ(symbol_table.find(names[symbol]), symbol);
+      EXPECT_EQ(symbol_table.find("valuezzzz"),
+                tokenizer::SymbolTable::kNoSymbol);
+    }
+    return fastest_time;
+  };
+
+  auto prefix_time = intern_names(get_names(true));
+  auto suffix_time = intern_names(get_names(false));
+  // Clustered probes made the common prefix over 10 times slower.
+  EXPECT_LT(prefix_time, 5 * suffix_time);
+}
@@ -1,5 +1,15 @@
 #include "gtest/gtest.h"
 
+#include <unistd.h>
+
+#include <cstdio>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "tokenizer/tokenizer.h"
 
 class TokenizerTest : public ::testing::Test {
@@ -89,3 +99,505 @@ TEST_F(TokenizerTest_NumericAddition_Test, ParenthesizedExpression) {
   EXPECT_EQ(eleventh_token.get_lexeme(), ")");
   EXPECT_EQ(tokenizer_for_lang.has_more(), false);
 }
+
+TEST_F(TokenizerTest, FirstDeclaredTokenTypeWinsTies) {
+  tokenizer::Tokenizer plus_first({
+      {"ab", tokenizer::TokenType::plus},
+      {"(a|b)(a|b)", tokenizer::TokenType::minus}});
+  tokenizer::Tokenizer minus_first({
+      {"(a|b)(a|b)", tokenizer::TokenType::minus},
+      {"ab", tokenizer::TokenType::plus}});
+
+  plus_first.tokenize("abba");
+  auto first_token = plus_first.get_next_token();
+  auto second_token = plus_first.get_next_token();
+  minus_first.tokenize("ab");
+  auto third_token = minus_first.get_next_token();
+
+  EXPECT_EQ(first_token.get_token_type(), tokenizer::TokenType::plus);
+  EXPECT_EQ(second_token.get_token_type(), tokenizer::TokenType::minus);
+  EXPECT_EQ(second_token.get_lexeme(), "ba");
+  EXPECT_EQ(third_token.get_token_type(), tokenizer::TokenType::minus);
+}
+
+TEST_F(TokenizerTest, InvalidInputStops) {
+  tokenizer_for_lang.tokenize("12?3");
+  auto first_token = tokenizer_for_lang.get_next_token();
+  auto second_token = tokenizer_for_lang.get_next_token();
+
+  EXPECT_EQ(first_token.get_lexeme(), "12");
+  EXPECT_EQ(second_token.get_token_type(), tokenizer::TokenType::invalid);
+  EXPECT_EQ(second_token.get_lexeme(), "");
+  EXPECT_EQ(tokenizer_for_lang.has_more(), false);
+}
+
+TEST_F(TokenizerTest, CombinedAutomatonIsMinimized) {
+  // A start state, identifiers, numbers, one state per operator and seven
+  // states in the middle of the UTF-8 sequences of identifiers.
+  EXPECT_EQ(tokenizer_for_lang.get_number_of_states(), 18);
+  EXPECT_GT(tokenizer_for_lang.get_number_of_unminimized_states(),
+            tokenizer_for_lang.get_number_of_states());
+}
+
+TEST_F(TokenizerTest, BytesShareClasses) {
+  // Letters, digits, one class for each of the seven operator characters,
+  // one for every other byte and eleven for the ranges of lead and
+  // continuation bytes of UTF-8 sequences.
+  EXPECT_EQ(tokenizer_for_lang.get_number_of_classes(), 21);
+}
+
+TEST_F(TokenizerTest, LexemesPointIntoInput) {
+  std::string input = "abc+12";
+  tokenizer_for_lang.tokenize(input);
+  auto first_token = tokenizer_for_lang.get_next_token();
+  auto second_token = tokenizer_for_lang.get_next_token();
+  auto third_token = tokenizer_for_lang.get_next_token();
+
+  EXPECT_EQ(first_token.get_lexeme().data(), input.data());
+  EXPECT_EQ(second_token.get_lexeme().data(), input.data() + 3);
+  EXPECT_EQ(third_token.get_lexeme().data(), input.data() + 4);
+  EXPECT_EQ(third_token.get_lexeme().size(), 2);
+}
+
+TEST_F(TokenizerTest, StreamedTokensMatchAcrossChunks) {
+  std::string input = "(adf2123==3123)*x-99/(y==z)";
+  std::vector<std::pair<tokenizer::TokenType, std::string>> expected_tokens;
+  tokenizer_for_lang.tokenize(input);
+  while (tokenizer_for_lang.has_more()) {
+    auto token = tokenizer_for_lang.get_next_token();
+    expected_tokens.emplace_back(
+        token.get_token_type(), std::string(token.get_lexeme()));
+  }
+
+  for (std::size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+    std::istringstream input_stream(input);
+    std::vector<std::pair<tokenizer::TokenType, std::string>> streamed_tokens;
+    std::size_t expected_offset = 0;
+    tokenizer_for_lang.tokenize_stream(
+        input_stream,
+        [&](tokenizer::Token token, std::size_t offset) {
+          EXPECT_EQ(offset, expected_offset);
+          expected_offset += token.get_lexeme().size();
+          streamed_tokens.emplace_back(
+              token.get_token_type(), std::string(token.get_lexeme()));
+        },
+        chunk_size);
+
+    EXPECT_EQ(streamed_tokens, expected_tokens);
+  }
+}
+
+TEST_F(TokenizerTest, StreamStopsOnInvalidInput) {
+  std::istringstream input_stream("12+=?3");
+  std::vector<tokenizer::TokenType> token_types;
+  std::size_t invalid_offset = 0;
+  tokenizer_for_lang.tokenize_stream(
+      input_stream,
+      [&](tokenizer::Token token, std::size_t offset) {
+        token_types.push_back(token.get_token_type());
+        invalid_offset = offset;
+      },
+      2);
+
+  std::vector<tokenizer::TokenType> expected_token_types = {
+      tokenizer::TokenType::number, tokenizer::TokenType::plus,
+      tokenizer::TokenType::equals, tokenizer::TokenType::invalid};
+  EXPECT_EQ(token_types, expected_token_types);
+  EXPECT_EQ(invalid_offset, 4);
+}
+
+TEST_F(TokenizerTest, StreamFromFileDescriptor) {
+  int pipe_file_descriptors[2];
+  ASSERT_EQ(pipe(pipe_file_descriptors), 0);
+  std::string input = "abc==12";
+  ASSERT_EQ(write(pipe_file_descriptors[1], input.data(), input.size()),
+            input.size());
+  close(pipe_file_descriptors[1]);
+
+  std::vector<std::string> lexemes;
+  std::vector<std::size_t> offsets;
+  EXPECT_EQ(tokenizer_for_lang.tokenize_stream(
+                pipe_file_descriptors[0],
+                [&](tokenizer::Token token, std::size_t offset) {
+                  lexemes.emplace_back(token.get_lexeme());
+                  offsets.push_back(offset);
+                },
+                4),
+            true);
+  close(pipe_file_descriptors[0]);
+
+  std::vector<std::string> expected_lexemes = {"abc", "==", "12"};
+  std::vector<std::size_t> expected_offsets = {0, 3, 5};
+  EXPECT_EQ(lexemes, expected_lexemes);
+  EXPECT_EQ(offsets, expected_offsets);
+}
+
+TEST_F(TokenizerTest, StreamReportsReadErrors) {
+  // Reading the write end of a pipe fails with EBADF.
+  int pipe_file_descriptors[2];
+  ASSERT_EQ(pipe(pipe_file_descriptors), 0);
+  auto number_of_tokens = 0;
+  EXPECT_EQ(tokenizer_for_lang.tokenize_stream(
+                pipe_file_descriptors[1],
+                [&](tokenizer::Token, std::size_t) { ++number_of_tokens; }),
+            false);
+  EXPECT_EQ(number_of_tokens, 0);
+  close(pipe_file_descriptors[0]);
+  close(pipe_file_descriptors[1]);
+}
+
+TEST_F(TokenizerTest, TokenizeAllMatchesGetNextToken) {
+  std::string input = "(adf2123==3123)*x-99/(y=z)";
+  auto tokens = tokenizer_for_lang.tokenize_all(input);
+
+  tokenizer_for_lang.tokenize(input);
+  std::size_t idx = 0;
+  while (tokenizer_for_lang.has_more()) {
+    auto token = tokenizer_for_lang.get_next_token();
+    ASSERT_LT(idx, tokens.size());
+    EXPECT_EQ(tokens.get_token_type(idx), token.get_token_type());
+    EXPECT_EQ(tokens.get_lexeme(idx), token.get_lexeme());
+    EXPECT_EQ(tokens.get_offset(idx), token.get_lexeme().data() - input.data());
+    ++idx;
+  }
+  EXPECT_EQ(idx, tokens.size());
+}
+
+TEST_F(TokenizerTest, TokenizeAllStopsOnInvalidInput) {
+  auto tokens = tokenizer_for_lang.tokenize_all("ab+?3");
+
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens.get_token_type(2), tokenizer::TokenType::invalid);
+  EXPECT_EQ(tokens.get_offset(2), 3);
+  EXPECT_EQ(tokens.get_length(2), 0);
+}
+
+TEST_F(TokenizerTest, SavedTokenizerLoads) {
+  tokenizer::Tokenizer custom_tokenizer({
+      {"[a-z][a-z]*", tokenizer::TokenType::id},
+      {"\\d\\d*", tokenizer::TokenType::number},
+      {"-", tokenizer::TokenType::minus}});
+  auto path = ::testing::TempDir() + "tokenizer_test.dfa";
+  ASSERT_EQ(custom_tokenizer.save(path), true);
+
+  ASSERT_EQ(tokenizer_for_lang.load(path), true);
+  std::remove(path.c_str());
+  EXPECT_EQ(tokenizer_for_lang.get_number_of_states(),
+            custom_tokenizer.get_number_of_states());
+
+  std::string input = "ab-12-c+";
+  auto tokens = tokenizer_for_lang.tokenize_all(input);
+  auto expected_tokens = custom_tokenizer.tokenize_all(input);
+  EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+  EXPECT_EQ(tokens.get_lengths(), expected_tokens.get_lengths());
+  EXPECT_EQ(tokens.get_token_type(tokens.size() - 1),
+            tokenizer::TokenType::invalid);
+  EXPECT_EQ(tokenizer_for_lang.load(path), false);
+}
+
+TEST_F(TokenizerTest, TokenizersShareOneProgram) {
+  auto program = std::make_shared<const tokenizer::LexerProgram>(
+      std::vector<std::pair<std::string, tokenizer::TokenType>>{
+          {"[a-z][a-z]*", tokenizer::TokenType::id},
+          {"\\d\\d*", tokenizer::TokenType::number},
+          {"-", tokenizer::TokenType::minus}});
+  tokenizer::Tokenizer shared_tokenizer(program);
+  EXPECT_EQ(shared_tokenizer.get_program(), program);
+  EXPECT_EQ(tokenizer::Tokenizer().get_program(),
+            tokenizer_for_lang.get_program());
+
+  // Every thread scans its own input with its own cursor over one program.
+  constexpr int kNumberOfThreads = 8;
+  std::vector<std::string> inputs;
+  for (auto thread_idx = 0; thread_idx < kNumberOfThreads; ++thread_idx) {
+    std::string input;
+    for (auto idx = 0; idx < 500; ++idx)
+      input += "ab-" + std::to_string(idx * (thread_idx + 1)) + "-c";
+    inputs.push_back(input);
+  }
+  std::vector<std::vector<std::string_view>> lexemes(kNumberOfThreads);
+  std::vector<std::thread> threads;
+  for (auto thread_idx = 0; thread_idx < kNumberOfThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx] {
+      tokenizer::Tokenizer thread_tokenizer(program);
+      thread_tokenizer.tokenize(inputs[thread_idx]);
+      while (thread_tokenizer.has_more())
+        lexemes[thread_idx].push_back(
+            thread_tokenizer.get_next_token().get_lexeme());
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto thread_idx = 0; thread_idx < kNumberOfThreads; ++thread_idx) {
+    auto expected_tokens = shared_tokenizer.tokenize_all(inputs[thread_idx]);
+    ASSERT_EQ(lexemes[thread_idx].size(), expected_tokens.size());
+    for (std::size_t idx = 0; idx < expected_tokens.size(); ++idx)
+      EXPECT_EQ(lexemes[thread_idx][idx], expected_tokens.get_lexeme(idx));
+  }
+}
+
+TEST_F(TokenizerTest, TokenizeAllInternsIdentifiers) {
+  std::string input = "x=value+x*(value2-value)";
+  tokenizer::SymbolTable symbol_table;
+  auto tokens = tokenizer_for_lang.tokenize_all(input, &symbol_table);
+  auto expected_tokens = tokenizer_for_lang.tokenize_all(input);
+
+  EXPECT_EQ(tokens.has_symbols(), true);
+  EXPECT_EQ(expected_tokens.has_symbols(), false);
+  EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+  EXPECT_EQ(tokens.get_offsets(), expected_tokens.get_offsets());
+  EXPECT_EQ(symbol_table.size(), 3);
+  ASSERT_EQ(tokens.get_symbols().size(), tokens.size());
+  for (std::size_t idx = 0; idx < tokens.size(); ++idx) {
+    if (tokens.get_token_type(idx) == tokenizer::TokenType::id) {
+      EXPECT_EQ(symbol_table.get_name(tokens.get_symbol(idx)),
+                tokens.get_lexeme(idx));
+    } else {
+      EXPECT_EQ(tokens.get_symbol(idx), tokenizer::SymbolTable::kNoSymbol);
+    }
+  }
+  EXPECT_EQ(tokens.get_symbol(0), tokens.get_symbol(4));
+  EXPECT_EQ(tokens.get_symbol(2), tokens.get_symbol(9));
+  EXPECT_NE(tokens.get_symbol(2), tokens.get_symbol(7));
+  EXPECT_EQ(expected_tokens.get_symbol(0), tokenizer::SymbolTable::kNoSymbol);
+}
+
+TEST_F(TokenizerTest, NonAsciiIdentifiers) {
+  // "größe=π*r2", "日本+x" and an identifier cut off in the middle of its
+  // last character.
+  std::string input = "gr\xC3\xB6\xC3\x9F" "e=\xCF\x80*r2+"
+      "\xE6\x97\xA5\xE6\x9C\xAC+x-\xF0\x9F";
+  tokenizer::SymbolTable symbol_table;
+  auto tokens = tokenizer_for_lang.tokenize_all(input, &symbol_table);
+
+  std::vector<tokenizer::TokenType> expected_token_types = {
+      tokenizer::TokenType::id, tokenizer::TokenType::equals,
+      tokenizer::TokenType::id, tokenizer::TokenType::star,
+      tokenizer::TokenType::id, tokenizer::TokenType::plus,
+      tokenizer::TokenType::id, tokenizer::TokenType::plus,
+      tokenizer::TokenType::id, tokenizer::TokenType::minus,
+      tokenizer::TokenType::invalid};
+  ASSERT_EQ(tokens.size(), expected_token_types.size());
+  for (std::size_t idx = 0; idx < tokens.size(); ++idx)
+    EXPECT_EQ(tokens.get_token_type(idx), expected_token_types[idx]);
+  EXPECT_EQ(tokens.get_lexeme(0), "gr\xC3\xB6\xC3\x9F" "e");
+  EXPECT_EQ(tokens.get_lexeme(2), "\xCF\x80");
+  EXPECT_EQ(tokens.get_lexeme(6), "\xE6\x97\xA5\xE6\x9C\xAC");
+  EXPECT_EQ(symbol_table.get_name(tokens.get_symbol(2)), "\xCF\x80");
+
+  for (auto number_of_threads : {2, 5}) {
+    auto parallel_tokens = tokenizer_for_lang.tokenize_all_parallel(
+        input, number_of_threads, 1);
+    EXPECT_EQ(parallel_tokens.get_token_types(), tokens.get_token_types());
+    EXPECT_EQ(parallel_tokens.get_offsets(), tokens.get_offsets());
+  }
+}
+
+TEST_F(TokenizerTest, KeywordsAreReclassifiedIdentifiers) {
+  std::string input = "if(iffy==1)return(x)else(fn)*while2+while";
+  tokenizer::SymbolTable symbol_table;
+  auto tokens = tokenizer_for_lang.tokenize_all(input, &symbol_table);
+
+  std::vector<std::pair<std::size_t, tokenizer::TokenType>> expected_types = {
+      {0, tokenizer::TokenType::if_keyword},
+      {2, tokenizer::TokenType::id},
+      {6, tokenizer::TokenType::return_keyword},
+      {10, tokenizer::TokenType::else_keyword},
+      {12, tokenizer::TokenType::fn_keyword},
+      {15, tokenizer::TokenType::id},
+      {17, tokenizer::TokenType::while_keyword}};
+  for (const auto& [idx, token_type] : expected_types)
+    EXPECT_EQ(tokens.get_token_type(idx), token_type) << idx;
+  // Only iffy, x and while2 are identifiers.
+  EXPECT_EQ(symbol_table.size(), 3);
+  EXPECT_EQ(tokens.get_symbol(0), tokenizer::SymbolTable::kNoSymbol);
+
+  tokenizer_for_lang.tokenize(input);
+  for (std::size_t idx = 0; idx < tokens.size(); ++idx)
+    EXPECT_EQ(tokenizer_for_lang.get_next_token().get_token_type(),
+              tokens.get_token_type(idx));
+  auto parallel_tokens = tokenizer_for_lang.tokenize_all_parallel(input, 3, 1);
+  EXPECT_EQ(parallel_tokens.get_token_types(), tokens.get_token_types());
+
+  std::vector<tokenizer::TokenType> streamed_types;
+  std::istringstream stream(input);
+  tokenizer_for_lang.tokenize_stream(
+      stream, [&](tokenizer::Token token, std::size_t) {
+        streamed_types.push_back(token.get_token_type());
+      }, 4);
+  ASSERT_EQ(streamed_types.size(), tokens.size());
+  for (std::size_t idx = 0; idx < tokens.size(); ++idx)
+    EXPECT_EQ(streamed_types[idx], tokens.get_token_type(idx));
+
+  // Typing one more letter turns the keyword into an identifier.
+  std::string edited_input = "iff(iffy==1)return(x)else(fn)*while2+while";
+  tokenizer_for_lang.retokenize(&tokens, edited_input, {2, 0, "f"});
+  EXPECT_EQ(tokens.get_token_type(0), tokenizer::TokenType::id);
+}
+
+TEST_F(TokenizerTest, SavedKeywordsLoad) {
+  tokenizer::Tokenizer custom_tokenizer(
+      {{"[a-z][a-z]*", tokenizer::TokenType::id},
+       {"-", tokenizer::TokenType::minus}},
+      {{"let", tokenizer::TokenType::let_keyword},
+       {"for", tokenizer::TokenType::for_keyword}});
+  auto path = ::testing::TempDir() + "keyword_test.dfa";
+  ASSERT_EQ(custom_tokenizer.save(path), true);
+  ASSERT_EQ(tokenizer_for_lang.load(path), true);
+  std::remove(path.c_str());
+
+  auto tokens = tokenizer_for_lang.tokenize_all("let-if-for");
+  ASSERT_EQ(tokens.size(), 5);
+  EXPECT_EQ(tokens.get_token_type(0), tokenizer::TokenType::let_keyword);
+  EXPECT_EQ(tokens.get_token_type(2), tokenizer::TokenType::id);
+  EXPECT_EQ(tokens.get_token_type(4), tokenizer::TokenType::for_keyword);
+}
+
+TEST_F(TokenizerTest, InvalidKeywordsAreReported) {
+  std::vector<std::pair<std::string, tokenizer::TokenType>> token_definitions =
+      {{"[a-z][a-z]*", tokenizer::TokenType::id},
+       {"-", tokenizer::TokenType::minus}};
+  EXPECT_EQ(tokenizer::Tokenizer().get_program()->is_valid(), true);
+  tokenizer::LexerProgram valid_program(
+      token_definitions, {{"let", tokenizer::TokenType::let_keyword}});
+  EXPECT_EQ(valid_program.is_valid(), true);
+
+  // Keywords are at most 16 bytes long.
+  std::string too_long_keyword(17, 'a');
+  tokenizer::Tokenizer long_keyword_tokenizer(
+      token_definitions,
+      {{"let", tokenizer::TokenType::let_keyword},
+       {too_long_keyword, tokenizer::TokenType::for_keyword}});
+  EXPECT_EQ(long_keyword_tokenizer.get_program()->is_valid(), false);
+  auto tokens = long_keyword_tokenizer.tokenize_all("let-" + too_long_keyword);
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens.get_token_type(0), tokenizer::TokenType::let_keyword);
+  EXPECT_EQ(tokens.get_token_type(2), tokenizer::TokenType::id);
+
+  tokenizer::LexerProgram duplicate_keyword_program(
+      token_definitions,
+      {{"let", tokenizer::TokenType::let_keyword},
+       {"let", tokenizer::TokenType::for_keyword}});
+  EXPECT_EQ(duplicate_keyword_program.is_valid(), false);
+  EXPECT_EQ(duplicate_keyword_program.get_keywords().find("let"),
+            static_cast<int>(tokenizer::TokenType::let_keyword));
+}
+
+TEST_F(TokenizerTest, RetokenizeKeepsSymbols) {
+  std::string source = "abc+de*abc";
+  tokenizer::SymbolTable symbol_table;
+  auto tokens = tokenizer_for_lang.tokenize_all(source, &symbol_table);
+
+  std::string edited_source = "abc+de*f(abc";
+  tokenizer_for_lang.retokenize(
+      &tokens, edited_source, {7, 0, "f("}, &symbol_table);
+  auto expected_tokens =
+      tokenizer_for_lang.tokenize_all(edited_source, &symbol_table);
+  EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+  EXPECT_EQ(tokens.get_offsets(), expected_tokens.get_offsets());
+  EXPECT_EQ(tokens.get_symbols(), expected_tokens.get_symbols());
+  EXPECT_EQ(symbol_table.size(), 3);
+}
+
+TEST_F(TokenizerTest, ParallelTokensMatchSequentialOnes) {
+  std::string input;
+  for (auto idx = 0; idx < 200; ++idx)
+    input += "(adf2123==3123)*x-99/(y=z)+accumulatedvalue" +
+        std::string(idx % 7, 'q') + "==1234567";
+  auto expected_tokens = tokenizer_for_lang.tokenize_all(input);
+
+  // Chunks of every few bytes split tokens at every position.
+  for (auto number_of_threads : {1, 2, 3, 8, 61}) {
+    auto tokens = tokenizer_for_lang.tokenize_all_parallel(
+        input, number_of_threads, 1);
+    EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+    EXPECT_EQ(tokens.get_offsets(), expected_tokens.get_offsets());
+    EXPECT_EQ(tokens.get_lengths(), expected_tokens.get_lengths());
+  }
+
+  // A token longer than several chunks.
+  std::string long_identifier = "x" + std::string(1000, 'a') + "+1";
+  auto tokens = tokenizer_for_lang.tokenize_all_parallel(
+      long_identifier, 16, 1);
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens.get_length(0), 1001);
+}
+
+TEST_F(TokenizerTest, ParallelTokenizeStopsOnInvalidInput) {
+  std::string input(4000, 'a');
+  input[1000] = '?';
+  input[3000] = '?';
+  auto tokens = tokenizer_for_lang.tokenize_all_parallel(input, 4, 1);
+  ASSERT_EQ(tokens.size(), 2);
+  EXPECT_EQ(tokens.get_token_type(1), tokenizer::TokenType::invalid);
+  EXPECT_EQ(tokens.get_offset(1), 1000);
+}
+
+TEST_F(TokenizerTest, ParallelTokenizeRelexesWrongGuesses) {
+  // Runs of 'a' split into pairs, so a chunk that starts at an odd offset
+  // never lines up with the true tokens and is lexed again entirely.
+  tokenizer::Tokenizer pairs_tokenizer({
+      {"aa", tokenizer::TokenType::id},
+      {"a", tokenizer::TokenType::number}});
+  std::string input(1001, 'a');
+  auto expected_tokens = pairs_tokenizer.tokenize_all(input);
+  for (auto number_of_threads : {2, 3, 7}) {
+    auto tokens = pairs_tokenizer.tokenize_all_parallel(
+        input, number_of_threads, 1);
+    EXPECT_EQ(tokens.get_token_types(), expected_tokens.get_token_types());
+    EXPECT_EQ(tokens.get_offsets(), expected_tokens.get_offsets());
+  }
+}
+
+TEST_F(TokenizerTest, RetokenizeMatchesTokenizeAll) {
+  tokenizer::Tokenizer lookahead_tokenizer({
+      {"abc", tokenizer::TokenType::id},
+      {"a", tokenizer::TokenType::number},
+      {"b", tokenizer::TokenType::plus},
+      {"c", tokenizer::TokenType::minus}});
+  tokenizer::Tokenizer unbounded_tokenizer({
+      {"a*b", tokenizer::TokenType::id},
+      {"a", tokenizer::TokenType::number}});
+  std::vector<std::pair<tokenizer::Tokenizer*, std::string>> cases = {
+      {&tokenizer_for_lang, "abc+(12==x1)*y-3=z/(42+value)"},
+      {&tokenizer_for_lang, ""},
+      {&lookahead_tokenizer, "abcabaabcbcaab"},
+      {&unbounded_tokenizer, "aaabaaaabab"}};
+  const std::string inserted_texts[] = {
+      "", "=", "a", "b", "c", "9", "(x)", "?", "abc"};
+
+  std::uint32_t random_state = 7;
+  auto get_random = [&random_state](std::size_t bound) {
+    random_state = random_state * 1664525 + 1013904223;
+    return (random_state >> 8) % bound;
+  };
+  for (auto& [tokenizer_for_case, source] : cases) {
+    auto tokens = tokenizer_for_case->tokenize_all(source);
+    for (auto edit_idx = 0; edit_idx < 300; ++edit_idx) {
+      tokenizer::TextEdit edit{};
+      edit.offset = get_random(source.size() + 1);
+      edit.deleted_length = get_random(
+          std::min<std::size_t>(source.size() - edit.offset, 3) + 1);
+      edit.inserted_text = inserted_texts[get_random(std::size(inserted_texts))];
+      // Keep the source from growing or shrinking for good.
+      if (source.size() > 60)
+        edit.inserted_text = "";
+      else if (source.size() < 5)
+        edit.deleted_length = 0;
+      auto edited_source = source.substr(0, edit.offset) +
+          std::string(edit.inserted_text) +
+          source.substr(edit.offset + edit.deleted_length);
+
+      tokenizer_for_case->retokenize(&tokens, edited_source, edit);
+      auto expected_tokens = tokenizer_for_case->tokenize_all(edited_source);
+      ASSERT_EQ(tokens.get_token_types(), expected_tokens.get_token_types())
+          << edited_source;
+      ASSERT_EQ(tokens.get_offsets(), expected_tokens.get_offsets())
+          << edited_source;
+      ASSERT_EQ(tokens.get_lengths(), expected_tokens.get_lengths())
+          << edited_source;
+      source = edited_source;
+    }
+  }
+}
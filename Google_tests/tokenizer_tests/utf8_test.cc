@@ -0,0 +1,109 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tokenizer/utf8.h"
+
+namespace {
+
+bool matches_sequence(
+    const tokenizer::Utf8Sequence& sequence, const unsigned char* bytes,
+    int length) {
+  if (sequence.length != length)
+    return false;
+  for (auto idx = 0; idx < length; ++idx) {
+    if (bytes[idx] < sequence.first_bytes[idx] ||
+        bytes[idx] > sequence.last_bytes[idx])
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(Utf8Test, EncodeAndDecode) {
+  unsigned char bytes[4];
+  EXPECT_EQ(tokenizer::encode_utf8('a', bytes), 1);
+  EXPECT_EQ(bytes[0], 'a');
+  EXPECT_EQ(tokenizer::encode_utf8(0xE9, bytes), 2);
+  EXPECT_EQ(std::string(bytes, bytes + 2), "\xC3\xA9");
+  EXPECT_EQ(tokenizer::encode_utf8(0x20AC, bytes), 3);
+  EXPECT_EQ(std::string(bytes, bytes + 3), "\xE2\x82\xAC");
+  EXPECT_EQ(tokenizer::encode_utf8(0x1F600, bytes), 4);
+  EXPECT_EQ(std::string(bytes, bytes + 4), "\xF0\x9F\x98\x80");
+
+  std::string input = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80";
+  EXPECT_EQ(tokenizer::get_character_length(input, 0), 1);
+  EXPECT_EQ(tokenizer::get_character_length(input, 1), 2);
+  EXPECT_EQ(tokenizer::decode_utf8(input, 1, 2), 0xE9);
+  EXPECT_EQ(tokenizer::get_character_length(input, 3), 3);
+  EXPECT_EQ(tokenizer::decode_utf8(input, 3, 3), 0x20AC);
+  EXPECT_EQ(tokenizer::get_character_length(input, 6), 4);
+  EXPECT_EQ(tokenizer::decode_utf8(input, 6, 4), 0x1F600);
+}
+
+TEST(Utf8Test, InvalidSequencesAreSingleBytes) {
+  // A lone continuation byte, an overlong encoding of '/', an encoded
+  // surrogate, a code point past U+10FFFF and a truncated sequence.
+  for (std::string input : {"\x80", "\xC0\xAF", "\xED\xA0\x80",
+                            "\xF4\x90\x80\x80", "\xE2\x82"})
+    EXPECT_EQ(tokenizer::get_character_length(input, 0), 1);
+}
+
+TEST(Utf8Test, SplitTwoByteRange) {
+  auto sequences = tokenizer::split_into_utf8_sequences({0x80, 0x7FF});
+  ASSERT_EQ(sequences.size(), 1);
+  EXPECT_EQ(sequences[0].length, 2);
+  EXPECT_EQ(sequences[0].first_bytes[0], 0xC2);
+  EXPECT_EQ(sequences[0].last_bytes[0], 0xDF);
+  EXPECT_EQ(sequences[0].first_bytes[1], 0x80);
+  EXPECT_EQ(sequences[0].last_bytes[1], 0xBF);
+
+  // U+00E9 to U+0101 crosses from lead byte C3 to C4.
+  sequences = tokenizer::split_into_utf8_sequences({0xE9, 0x101});
+  ASSERT_EQ(sequences.size(), 2);
+  EXPECT_EQ(sequences[0].first_bytes[0], 0xC3);
+  EXPECT_EQ(sequences[0].first_bytes[1], 0xA9);
+  EXPECT_EQ(sequences[0].last_bytes[1], 0xBF);
+  EXPECT_EQ(sequences[1].first_bytes[0], 0xC4);
+  EXPECT_EQ(sequences[1].first_bytes[1], 0x80);
+  EXPECT_EQ(sequences[1].last_bytes[1], 0x81);
+}
+
+TEST(Utf8Test, SequencesMatchExactlyTheRange) {
+  std::vector<tokenizer::CodePointRange> ranges = {
+      {0x80, 0x10FFFF}, {0xE9, 0x20AC}, {0xD000, 0xE000}, {0x3B1, 0x3C9},
+      {0xFFFF, 0x10000}, {0x12345, 0x54321}};
+  for (auto range : ranges) {
+    auto sequences = tokenizer::split_into_utf8_sequences(range);
+    for (std::uint32_t code_point = 0x80; code_point <= 0x10FFFF;
+         ++code_point) {
+      unsigned char bytes[4];
+      auto length = tokenizer::encode_utf8(code_point, bytes);
+      auto number_of_matches = 0;
+      for (const auto& sequence : sequences)
+        number_of_matches += matches_sequence(sequence, bytes, length);
+      auto is_surrogate = code_point >= tokenizer::kFirstSurrogate &&
+          code_point <= tokenizer::kLastSurrogate;
+      auto is_in_range = code_point >= range.first &&
+          code_point <= range.last && !is_surrogate;
+      ASSERT_EQ(number_of_matches, is_in_range ? 1 : 0)
+          << std::hex << range.first << "-" << range.last << " "
+          << code_point;
+    }
+  }
+}
+
+TEST(Utf8Test, ComplementRanges) {
+  auto complement_ranges = tokenizer::complement_code_point_ranges(
+      {{'a', 'z'}, {0x80, 0xFF}, {'A', 'Z'}, {0x100, 0x10FFFF}});
+  std::vector<tokenizer::CodePointRange> expected_ranges = {
+      {0, 'A' - 1}, {'Z' + 1, 'a' - 1}, {'z' + 1, 0x7F}};
+  EXPECT_EQ(complement_ranges, expected_ranges);
+
+  complement_ranges = tokenizer::complement_code_point_ranges({});
+  expected_ranges = {{0, 0xD7FF}, {0xE000, 0x10FFFF}};
+  EXPECT_EQ(complement_ranges, expected_ranges);
+}
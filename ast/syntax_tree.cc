@@ -1,21 +1,29 @@
 #include "ast/syntax_tree.h"
 
 #include <algorithm>
+#include <cstddef>
 
 namespace ast {
 
-SyntaxTreeNode construct_syntax_tree(
-    std::vector<tokenizer::Token> tokens,
+/**
+ * Replays the parser's moves. Shifts push a leaf holding the lexeme and the
+ * symbol of the next token, which get_lexeme and get_symbol return by index,
+ * and reductions apply the syntax directed definition of the reduced
+ * production.
+ */
+template <typename LexemeGetter, typename SymbolGetter>
+SyntaxTreeNode construct_syntax_tree_from_lexemes(
+    const LexemeGetter& get_lexeme, const SymbolGetter& get_symbol,
     const std::vector<std::pair<
         parser::ParsingActionType,
         parser::Production>>& parser_outputs) {
-  auto token_idx = 0;
+  std::size_t token_idx = 0;
   std::deque<SyntaxTreeNode> stack;
   for (const auto& parser_output : parser_outputs) {
     auto parser_action_type = parser_output.first;
     if (parser_action_type == parser::ParsingActionType::shift) {
-      auto node_data = tokens[token_idx].get_lexeme();
-      auto node = SyntaxTreeNode(node_data);
+      auto node_data = std::string(get_lexeme(token_idx));
+      auto node = SyntaxTreeNode(node_data, {}, get_symbol(token_idx));
       stack.push_back(node);
       token_idx += 1;
     } else if (parser_action_type == parser::ParsingActionType::reduce) {
@@ -49,5 +57,38 @@ SyntaxTreeNode construct_syntax_tree(
   return stack.back();
 }
 
-}  // namespace ast
+SyntaxTreeNode construct_syntax_tree(
+    std::vector<tokenizer::Token> tokens,
+    const std::vector<std::pair<
+        parser::ParsingActionType,
+        parser::Production>>& parser_outputs) {
+  return construct_syntax_tree_from_lexemes(
+      [&tokens](std::size_t idx) { return tokens[idx].get_lexeme(); },
+      [](std::size_t) { return tokenizer::SymbolTable::kNoSymbol; },
+      parser_outputs);
+}
+
+SyntaxTreeNode construct_syntax_tree(
+    const tokenizer::TokenBuffer& tokens,
+    const std::vector<std::pair<
+        parser::ParsingActionType,
+        parser::Production>>& parser_outputs) {
+  return construct_syntax_tree_from_lexemes(
+      [&tokens](std::size_t idx) { return tokens.get_lexeme(idx); },
+      [&tokens](std::size_t idx) { return tokens.get_symbol(idx); },
+      parser_outputs);
+}
+
+std::string SyntaxTreeNode::get_data() {
+  return data_;
+}
 
+std::vector<SyntaxTreeNode> SyntaxTreeNode::get_children() {
+  return children_;
+}
+
+std::uint32_t SyntaxTreeNode::get_symbol() {
+  return symbol_;
+}
+
+}  // namespace ast
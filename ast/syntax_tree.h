@@ -1,6 +1,7 @@
 #ifndef AST_SYNTAX_TREE_H_
 #define AST_SYNTAX_TREE_H_
 
+#include <cstdint>
 #include <deque>
 #include <string>
 #include <utility>
@@ -11,17 +12,28 @@
 
 namespace ast {
 
+/**
+ * A leaf made from an identifier of interned tokens also keeps the symbol of
+ * the identifier, so identifiers compare as integers. Other nodes have the
+ * symbol tokenizer::SymbolTable::kNoSymbol.
+ */
 class SyntaxTreeNode {
  private:
   std::string data_;
   std::vector<SyntaxTreeNode> children_;
+  std::uint32_t symbol_ = tokenizer::SymbolTable::kNoSymbol;
 
  public:
   SyntaxTreeNode() = default;
-  SyntaxTreeNode(std::string data, std::vector<SyntaxTreeNode> children = {})
-    :data_{std::move(data)}, children_{std::move(children)}
+  SyntaxTreeNode(std::string data, std::vector<SyntaxTreeNode> children = {},
+                 std::uint32_t symbol = tokenizer::SymbolTable::kNoSymbol)
+    :data_{std::move(data)}, children_{std::move(children)}, symbol_{symbol}
   {}
   ~SyntaxTreeNode() = default;
+
+  std::string get_data();
+  std::vector<SyntaxTreeNode> get_children();
+  std::uint32_t get_symbol();
 };
 
 SyntaxTreeNode construct_syntax_tree(
@@ -29,6 +41,11 @@ SyntaxTreeNode construct_syntax_tree(
     const std::vector<std::pair<
         parser::ParsingActionType,
         parser::Production>>& parser_outputs);
+SyntaxTreeNode construct_syntax_tree(
+    const tokenizer::TokenBuffer& tokens,
+    const std::vector<std::pair<
+        parser::ParsingActionType,
+        parser::Production>>& parser_outputs);
 
 }  // namespace ast
 
@@ -1,5 +1,7 @@
 #include "parser/grammar.h"
 
+#include <algorithm>
+#include <iterator>
 #include <set>
 
 namespace parser {
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iterator>
 #include <utility>
 
@@ -170,6 +171,20 @@ std::string map_token_type_to_terminal(tokenizer::TokenType token_type) {
     return "(";
   } else if (token_type == tokenizer::TokenType::closed_paren) {
     return ")";
+  } else if (token_type == tokenizer::TokenType::if_keyword) {
+    return "if";
+  } else if (token_type == tokenizer::TokenType::else_keyword) {
+    return "else";
+  } else if (token_type == tokenizer::TokenType::while_keyword) {
+    return "while";
+  } else if (token_type == tokenizer::TokenType::for_keyword) {
+    return "for";
+  } else if (token_type == tokenizer::TokenType::let_keyword) {
+    return "let";
+  } else if (token_type == tokenizer::TokenType::fn_keyword) {
+    return "fn";
+  } else if (token_type == tokenizer::TokenType::return_keyword) {
+    return "return";
   } else if (token_type == tokenizer::TokenType::dollar) {
     return "$";
   }
@@ -251,14 +266,34 @@ Parser::Parser(Grammar grammar) {
   }
 }
 
+/**
+ * The parser only looks at token types, so the tokens are copied into a
+ * TokenBuffer without their lexemes.
+ */
 void Parser::parse(std::vector<tokenizer::Token> tokens) {
+  tokenizer::TokenBuffer token_buffer;
+  token_buffer.reserve(tokens.size());
+  for (auto token : tokens) {
+    token_buffer.push_back(token.get_token_type(), 0, 0);
+  }
+  parse(std::move(token_buffer));
+}
+
+/**
+ * Running past the end of the tokens reads as the end marker $, so a buffer
+ * from Tokenizer::tokenize_all can be parsed as is.
+ */
+void Parser::parse(tokenizer::TokenBuffer tokens) {
   input_ = std::move(tokens);
   current_position_ = 0;
 }
 
 std::pair<ParsingActionType, Production> Parser::make_next_move() {
-  auto next_token = input_[current_position_];
-  auto token_string = map_token_type_to_terminal(next_token.get_token_type());
+  auto token_type = tokenizer::TokenType::dollar;
+  if (current_position_ < input_.size()) {
+    token_type = input_.get_token_type(current_position_);
+  }
+  auto token_string = map_token_type_to_terminal(token_type);
   auto current_state = stack_.back();
   auto next_action = table_[current_state][token_string];
 
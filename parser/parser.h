@@ -1,6 +1,7 @@
 #ifndef PARSER_PARSER_H_
 #define PARSER_PARSER_H_
 
+#include <cstddef>
 #include <deque>
 #include <string>
 #include <unordered_map>
@@ -110,8 +111,8 @@ class Parser {
   std::deque<int> stack_;
   bool has_accepted_;
   bool is_stuck_;
-  std::vector<tokenizer::Token> input_;
-  int current_position_;
+  tokenizer::TokenBuffer input_;
+  std::size_t current_position_;
 
  public:
   Parser() = default;
@@ -119,6 +120,7 @@ class Parser {
   ~Parser() = default;
 
   void parse(std::vector<tokenizer::Token> tokens);
+  void parse(tokenizer::TokenBuffer tokens);
   std::pair<ParsingActionType, Production> make_next_move();
   bool has_accepted() {
     return has_accepted_;
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+
+#include "tokenizer/scanner_generator.h"
+#include "tokenizer/tokenizer.h"
+
+/**
+ * Usage: generate_scanner <scanner name> <output directory> [automaton file]
+ *
+ * Writes <scanner name>.h and <scanner name>.cc for the automaton saved with
+ * Tokenizer::save, or for the built-in token set if no file is given.
+ */
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "usage: " << argv[0]
+              << " <scanner name> <output directory> [automaton file]\n";
+    return 1;
+  }
+  tokenizer::Tokenizer tokenizer_for_lang;
+  if (argc == 4 && !tokenizer_for_lang.load(argv[3])) {
+    std::cerr << "cannot load " << argv[3] << "\n";
+    return 1;
+  }
+  if (!tokenizer::write_scanner_files(
+          *tokenizer_for_lang.get_program(), argv[1], argv[2])) {
+    std::cerr << "cannot write " << argv[1] << " to " << argv[2] << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,326 @@
+#include "tokenizer/automaton_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+namespace tokenizer {
+
+static_assert(sizeof(int) == sizeof(std::int32_t));
+static_assert(std::is_trivially_copyable_v<SelfLoop>);
+static_assert(std::is_trivially_copyable_v<KeywordSlot>);
+static_assert(sizeof(AutomatonFileHeader) % 8 == 0);
+
+namespace {
+
+struct SectionLayout {
+  std::uint64_t byte_classes_offset;
+  std::uint64_t transition_table_offset;
+  std::uint64_t final_state_tags_offset;
+  std::uint64_t self_loops_offset;
+  std::uint64_t tag_values_offset;
+  std::uint64_t keyword_pilots_offset;
+  std::uint64_t keyword_slots_offset;
+  std::uint64_t file_size;
+};
+
+std::uint64_t align_section(std::uint64_t offset) {
+  return (offset + 7) & ~std::uint64_t{7};
+}
+
+SectionLayout get_section_layout(
+    std::uint64_t number_of_states, std::uint64_t number_of_classes,
+    std::uint64_t number_of_tags, std::uint64_t number_of_keyword_buckets,
+    std::uint64_t number_of_keyword_slots) {
+  SectionLayout layout{};
+  layout.byte_classes_offset = sizeof(AutomatonFileHeader);
+  layout.transition_table_offset = align_section(
+      layout.byte_classes_offset + DeterministicFiniteAutomaton::kNumberOfSymbols);
+  layout.final_state_tags_offset = align_section(
+      layout.transition_table_offset +
+      number_of_states * number_of_classes * sizeof(std::int32_t));
+  layout.self_loops_offset = align_section(
+      layout.final_state_tags_offset + number_of_states * sizeof(std::int32_t));
+  layout.tag_values_offset = align_section(
+      layout.self_loops_offset + number_of_states * sizeof(SelfLoop));
+  layout.keyword_pilots_offset = align_section(
+      layout.tag_values_offset + number_of_tags * sizeof(std::int32_t));
+  layout.keyword_slots_offset = align_section(
+      layout.keyword_pilots_offset +
+      number_of_keyword_buckets * sizeof(std::uint32_t));
+  layout.file_size = align_section(
+      layout.keyword_slots_offset +
+      number_of_keyword_slots * sizeof(KeywordSlot));
+  return layout;
+}
+
+std::uint64_t compute_checksum(const char* data, std::size_t size) {
+  std::uint64_t checksum = 14695981039346656037ULL;
+  for (std::size_t idx = 0; idx < size; ++idx) {
+    checksum ^= static_cast<unsigned char>(data[idx]);
+    checksum *= 1099511628211ULL;
+  }
+  return checksum;
+}
+
+/**
+ * Checks that every state, class and tag in the tables is in range, so a
+ * loaded automaton never indexes out of its tables, and that the self loops
+ * match the transition table.
+ */
+bool are_tables_valid(
+    const AutomatonFileHeader& header,
+    std::span<const std::uint8_t> byte_classes,
+    std::span<const int> transition_table,
+    std::span<const int> final_state_tags,
+    std::span<const SelfLoop> self_loops) {
+  if (header.start_state < 0 || header.start_state >= header.number_of_states)
+    return false;
+  for (auto byte_class : byte_classes) {
+    if (byte_class >= header.number_of_classes)
+      return false;
+  }
+  for (auto state : transition_table) {
+    if (state < DeterministicFiniteAutomaton::kDeadState ||
+        state >= header.number_of_states)
+      return false;
+  }
+  for (auto final_state_tag : final_state_tags) {
+    if (final_state_tag < -1 || final_state_tag >= header.number_of_tags)
+      return false;
+  }
+  // find_self_loop_end skips bytes by the ranges alone, so a range that
+  // disagrees with the table would skip bytes the automaton moves on. Each
+  // record has to be the one find_self_loop computes from the table.
+  for (auto state = 0; state < header.number_of_states; ++state) {
+    const auto& self_loop = self_loops[state];
+    auto table_self_loop = find_self_loop(
+        state, header.number_of_classes, byte_classes, transition_table);
+    if (self_loop.number_of_ranges != table_self_loop.number_of_ranges)
+      return false;
+    for (auto range = 0; range < self_loop.number_of_ranges; ++range) {
+      if (self_loop.range_starts[range] !=
+              table_self_loop.range_starts[range] ||
+          self_loop.range_ends[range] != table_self_loop.range_ends[range])
+        return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks that the keyword table has a power of 2 of buckets and of slots,
+ * or none of either, and that no keyword is too long.
+ */
+bool is_keyword_table_valid(
+    const AutomatonFileHeader& header,
+    std::span<const KeywordSlot> keyword_slots) {
+  auto number_of_buckets = header.number_of_keyword_buckets;
+  auto number_of_slots = header.number_of_keyword_slots;
+  if (number_of_buckets < 0 || number_of_slots < 0 ||
+      (number_of_buckets == 0) != (number_of_slots == 0) ||
+      (number_of_buckets & (number_of_buckets - 1)) != 0 ||
+      (number_of_slots & (number_of_slots - 1)) != 0 || number_of_slots == 1)
+    return false;
+  for (const auto& keyword_slot : keyword_slots) {
+    if (keyword_slot.length > KeywordSlot::kMaxLength)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+/**
+ * Writes the automaton to a file next to path and renames it over path, so
+ * processes that have the old file mapped keep reading a complete file.
+ * Returns false if the file cannot be written.
+ */
+bool write_automaton_file(
+    const std::string& path, const DeterministicFiniteAutomaton& automaton,
+    int number_of_unminimized_states, const std::vector<int>& tag_values,
+    const KeywordTable& keywords) {
+  auto byte_classes = automaton.get_byte_classes();
+  auto transition_table = automaton.get_transition_table();
+  auto final_state_tags = automaton.get_final_state_tags();
+  auto self_loops = automaton.get_self_loops();
+  auto keyword_pilots = keywords.get_pilots();
+  auto keyword_slots = keywords.get_slots();
+  auto number_of_states = final_state_tags.size();
+  auto number_of_classes = transition_table.size() / number_of_states;
+  auto layout = get_section_layout(
+      number_of_states, number_of_classes, tag_values.size(),
+      keyword_pilots.size(), keyword_slots.size());
+
+  std::string image(layout.file_size, '\0');
+  std::memcpy(
+      &image[layout.byte_classes_offset], byte_classes.data(),
+      byte_classes.size_bytes());
+  std::memcpy(
+      &image[layout.transition_table_offset], transition_table.data(),
+      transition_table.size_bytes());
+  std::memcpy(
+      &image[layout.final_state_tags_offset], final_state_tags.data(),
+      final_state_tags.size_bytes());
+  std::memcpy(
+      &image[layout.self_loops_offset], self_loops.data(),
+      self_loops.size_bytes());
+  std::memcpy(
+      &image[layout.tag_values_offset], tag_values.data(),
+      tag_values.size() * sizeof(std::int32_t));
+  std::memcpy(
+      &image[layout.keyword_pilots_offset], keyword_pilots.data(),
+      keyword_pilots.size_bytes());
+  std::memcpy(
+      &image[layout.keyword_slots_offset], keyword_slots.data(),
+      keyword_slots.size_bytes());
+
+  AutomatonFileHeader header{};
+  std::memcpy(header.magic, kAutomatonFileMagic, sizeof(header.magic));
+  header.version = kAutomatonFileVersion;
+  header.byte_order_mark = kAutomatonFileByteOrderMark;
+  header.file_size = layout.file_size;
+  header.start_state = automaton.get_start_state();
+  header.number_of_states = number_of_states;
+  header.number_of_classes = number_of_classes;
+  header.number_of_unminimized_states = number_of_unminimized_states;
+  header.number_of_tags = tag_values.size();
+  header.number_of_keyword_buckets = keyword_pilots.size();
+  header.number_of_keyword_slots = keyword_slots.size();
+  header.checksum = compute_checksum(
+      &image[sizeof(AutomatonFileHeader)],
+      image.size() - sizeof(AutomatonFileHeader));
+  std::memcpy(&image[0], &header, sizeof(header));
+
+  // mkstemp picks a name no other writer uses and creates the file with
+  // mode 0600, which we widen to 0644 so other processes can map it.
+  auto temporary_path = path + ".XXXXXX";
+  auto file_descriptor = mkstemp(temporary_path.data());
+  if (file_descriptor == -1)
+    return false;
+  auto is_written =
+      fchmod(file_descriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
+  for (std::size_t offset = 0; is_written && offset < image.size();) {
+    auto count = write(
+        file_descriptor, image.data() + offset, image.size() - offset);
+    if (count >= 0)
+      offset += count;
+    else if (errno != EINTR)
+      is_written = false;
+  }
+  is_written = close(file_descriptor) == 0 && is_written;
+  if (!is_written ||
+      std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Maps a file written by write_automaton_file read-only into memory and
+ * points the automaton and the keyword table, if asked for, at their
+ * tables, which stay mapped for as long as either or a copy of them lives.
+ * Nothing is parsed or copied besides the header and the tag values, but
+ * every page is read once to check the checksum and the tables. Processes
+ * mapping the same file share its pages.
+ *
+ * Returns false and leaves the outputs alone if the file cannot be mapped or
+ * is not a valid automaton file of this version.
+ */
+bool map_automaton_file(
+    const std::string& path, DeterministicFiniteAutomaton* automaton,
+    int* number_of_unminimized_states, std::vector<int>* tag_values,
+    KeywordTable* keywords) {
+  auto file_descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file_descriptor == -1)
+    return false;
+  struct stat file_status {};
+  if (fstat(file_descriptor, &file_status) != 0 ||
+      file_status.st_size < static_cast<off_t>(sizeof(AutomatonFileHeader))) {
+    close(file_descriptor);
+    return false;
+  }
+  std::size_t file_size = file_status.st_size;
+  auto* address = mmap(
+      nullptr, file_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+  close(file_descriptor);
+  if (address == MAP_FAILED)
+    return false;
+  std::shared_ptr<const void> mapping(
+      address, [file_size](const void* mapped_address) {
+        munmap(const_cast<void*>(mapped_address), file_size);
+      });
+  const auto* data = static_cast<const char*>(address);
+
+  AutomatonFileHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kAutomatonFileMagic, sizeof(header.magic)) !=
+          0 ||
+      header.version != kAutomatonFileVersion ||
+      header.byte_order_mark != kAutomatonFileByteOrderMark ||
+      header.file_size != file_size || header.number_of_states <= 0 ||
+      header.number_of_classes <= 0 ||
+      header.number_of_classes > DeterministicFiniteAutomaton::kNumberOfSymbols ||
+      header.number_of_tags < 0)
+    return false;
+  if (header.number_of_keyword_buckets < 0 ||
+      header.number_of_keyword_slots < 0)
+    return false;
+  auto layout = get_section_layout(
+      header.number_of_states, header.number_of_classes, header.number_of_tags,
+      header.number_of_keyword_buckets, header.number_of_keyword_slots);
+  if (layout.file_size != file_size ||
+      compute_checksum(
+          data + sizeof(AutomatonFileHeader),
+          file_size - sizeof(AutomatonFileHeader)) != header.checksum)
+    return false;
+
+  std::span<const std::uint8_t> byte_classes(
+      reinterpret_cast<const std::uint8_t*>(data + layout.byte_classes_offset),
+      DeterministicFiniteAutomaton::kNumberOfSymbols);
+  std::span<const int> transition_table(
+      reinterpret_cast<const int*>(data + layout.transition_table_offset),
+      static_cast<std::size_t>(header.number_of_states) *
+          header.number_of_classes);
+  std::span<const int> final_state_tags(
+      reinterpret_cast<const int*>(data + layout.final_state_tags_offset),
+      header.number_of_states);
+  std::span<const SelfLoop> self_loops(
+      reinterpret_cast<const SelfLoop*>(data + layout.self_loops_offset),
+      header.number_of_states);
+  std::span<const std::uint32_t> keyword_pilots(
+      reinterpret_cast<const std::uint32_t*>(
+          data + layout.keyword_pilots_offset),
+      header.number_of_keyword_buckets);
+  std::span<const KeywordSlot> keyword_slots(
+      reinterpret_cast<const KeywordSlot*>(data + layout.keyword_slots_offset),
+      header.number_of_keyword_slots);
+  if (!are_tables_valid(
+          header, byte_classes, transition_table, final_state_tags,
+          self_loops) ||
+      !is_keyword_table_valid(header, keyword_slots))
+    return false;
+
+  const auto* tag_values_start =
+      reinterpret_cast<const std::int32_t*>(data + layout.tag_values_offset);
+  tag_values->assign(
+      tag_values_start, tag_values_start + header.number_of_tags);
+  *number_of_unminimized_states = header.number_of_unminimized_states;
+  if (keywords != nullptr)
+    *keywords = KeywordTable(mapping, keyword_pilots, keyword_slots);
+  *automaton = DeterministicFiniteAutomaton(
+      std::move(mapping), header.start_state, header.number_of_classes,
+      byte_classes, transition_table, final_state_tags, self_loops);
+  return true;
+}
+
+}  // namespace tokenizer
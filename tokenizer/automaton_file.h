@@ -0,0 +1,62 @@
+#ifndef TOKENIZER_AUTOMATON_FILE_H_
+#define TOKENIZER_AUTOMATON_FILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tokenizer/finite_automaton.h"
+#include "tokenizer/keyword_table.h"
+
+namespace tokenizer {
+
+/**
+ * A compiled lexer saved to disk. The file starts with this header and is
+ * followed by, each section starting at a multiple of 8 bytes:
+ * 1. The byte class of each byte, 256 bytes.
+ * 2. The transition table, number_of_states * number_of_classes int32s.
+ * 3. The final state tag of each state, number_of_states int32s.
+ * 4. The self loop of each state, number_of_states SelfLoops.
+ * 5. The value of each tag, number_of_tags int32s. The Tokenizer stores the
+ *    token type accepted for each tag, and tags are in order of priority.
+ * 6. The pilots of the keyword table, number_of_keyword_buckets uint32s.
+ * 7. The slots of the keyword table, number_of_keyword_slots KeywordSlots.
+ *    A file without keywords has neither.
+ *
+ * Everything is in the byte order of the host that wrote the file. A reader
+ * with another byte order rejects it because byte_order_mark does not read
+ * as kAutomatonFileByteOrderMark. The checksum is FNV-1a over everything
+ * after the header.
+ */
+struct AutomatonFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order_mark;
+  std::uint64_t checksum;
+  std::uint64_t file_size;
+  std::int32_t start_state;
+  std::int32_t number_of_states;
+  std::int32_t number_of_classes;
+  std::int32_t number_of_unminimized_states;
+  std::int32_t number_of_tags;
+  std::int32_t number_of_keyword_buckets;
+  std::int32_t number_of_keyword_slots;
+  std::int32_t reserved;
+};
+
+constexpr char kAutomatonFileMagic[8] = {'R', 'O', 'A', 'D', 'Y', 'D', 'F', 'A'};
+constexpr std::uint32_t kAutomatonFileVersion = 2;
+constexpr std::uint32_t kAutomatonFileByteOrderMark = 0x01020304;
+
+bool write_automaton_file(
+    const std::string& path, const DeterministicFiniteAutomaton& automaton,
+    int number_of_unminimized_states, const std::vector<int>& tag_values,
+    const KeywordTable& keywords = KeywordTable());
+bool map_automaton_file(
+    const std::string& path, DeterministicFiniteAutomaton* automaton,
+    int* number_of_unminimized_states, std::vector<int>* tag_values,
+    KeywordTable* keywords = nullptr);
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_AUTOMATON_FILE_H_
@@ -1,186 +1,431 @@
 #include "tokenizer/finite_automaton.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <algorithm>
-#include <deque>
 #include <iterator>
-#include <set>
 #include <vector>
 
 namespace tokenizer {
 
-void TransitionGraphRow::add_input_state_pair(
-    const std::string& input_symbol, int state) {
-  adjacency_list_row_[input_symbol].insert(state);
+DeterministicFiniteAutomaton::DeterministicFiniteAutomaton()
+    :DeterministicFiniteAutomaton(AutomatonTables{
+        0, 1, ByteClasses{}, {kDeadState}, {-1}})
+{}
+
+DeterministicFiniteAutomaton::DeterministicFiniteAutomaton(
+    AutomatonTables tables)
+    :start_state_{tables.start_state},
+    number_of_classes_{tables.number_of_classes} {
+  auto stored_tables = std::make_shared<Tables>();
+  stored_tables->byte_classes = tables.byte_classes;
+  stored_tables->transition_table = std::move(tables.transition_table);
+  stored_tables->final_state_tags = std::move(tables.final_state_tags);
+  for (std::size_t state = 0;
+       state < stored_tables->final_state_tags.size(); ++state) {
+    stored_tables->self_loops.push_back(find_self_loop(
+        state, number_of_classes_, stored_tables->byte_classes,
+        stored_tables->transition_table));
+  }
+
+  byte_classes_ = stored_tables->byte_classes;
+  transition_table_ = stored_tables->transition_table;
+  final_state_tags_ = stored_tables->final_state_tags;
+  self_loops_ = stored_tables->self_loops;
+  storage_ = std::move(stored_tables);
 }
 
-void TransitionGraphRow::increment_values(int number) {
-  std::unordered_map<std::string, std::unordered_set<int>>
-    new_adjacency_list_row;
+DeterministicFiniteAutomaton::DeterministicFiniteAutomaton(
+    std::shared_ptr<const void> storage, int start_state,
+    int number_of_classes, std::span<const std::uint8_t> byte_classes,
+    std::span<const int> transition_table,
+    std::span<const int> final_state_tags,
+    std::span<const SelfLoop> self_loops)
+    :storage_{std::move(storage)}, start_state_{start_state},
+    number_of_classes_{number_of_classes}, byte_classes_{byte_classes},
+    transition_table_{transition_table}, final_state_tags_{final_state_tags},
+    self_loops_{self_loops}
+{}
+
+int DeterministicFiniteAutomaton::get_number_of_states() const {
+  return final_state_tags_.size();
+}
 
-  for (const auto& string_vertices_pair : adjacency_list_row_) {
-    auto input = string_vertices_pair.first;
-    auto vertices = string_vertices_pair.second;
-    for (auto vertex : vertices) {
-      new_adjacency_list_row[input].insert(vertex + number);
-    }
-  }
+int DeterministicFiniteAutomaton::get_number_of_classes() const {
+  return number_of_classes_;
+}
 
-  adjacency_list_row_ = new_adjacency_list_row;
+int DeterministicFiniteAutomaton::get_byte_class(
+    unsigned char input_byte) const {
+  return byte_classes_[input_byte];
 }
 
-std::unordered_set<std::string>
-    TransitionGraphRow::get_non_epsilon_transitions() {
-  std::unordered_set<std::string> non_epsilon_inputs;
+SelfLoop DeterministicFiniteAutomaton::get_self_loop(int state) const {
+  return self_loops_[state];
+}
 
-  for (const auto& input_states_pair : adjacency_list_row_) {
-    auto input = input_states_pair.first;
-    if (!input.empty())
-      non_epsilon_inputs.insert(input);
-  }
+int DeterministicFiniteAutomaton::get_start_state() const {
+  return start_state_;
+}
 
-  return non_epsilon_inputs;
+std::span<const std::uint8_t>
+    DeterministicFiniteAutomaton::get_byte_classes() const {
+  return byte_classes_;
 }
 
-std::unordered_set<int> TransitionGraphRow::operator[](
-    const std::string& input) {
-  return adjacency_list_row_[input];
+std::span<const int> DeterministicFiniteAutomaton::get_transition_table() const {
+  return transition_table_;
 }
 
-void TransitionGraph::add_transition(
-    int start_state, int end_state, const std::string& input_symbol) {
-  auto adjacency_list_row = adjacency_list_[start_state];
-  adjacency_list_row.add_input_state_pair(input_symbol, end_state);
-  adjacency_list_[start_state] = adjacency_list_row;
+std::span<const int> DeterministicFiniteAutomaton::get_final_state_tags() const {
+  return final_state_tags_;
 }
 
-void TransitionGraph::increment_vertex_numbers(int number) {
-  std::unordered_map<int, TransitionGraphRow> new_adjacency_list;
+std::span<const SelfLoop> DeterministicFiniteAutomaton::get_self_loops() const {
+  return self_loops_;
+}
 
-  for (const auto& vertex_row_pair : adjacency_list_) {
-    auto vertex = vertex_row_pair.first;
-    auto adjacency_list_row = vertex_row_pair.second;
-    adjacency_list_row.increment_values(number);
-    new_adjacency_list[vertex + number] = adjacency_list_row;
+/**
+ * Run the automaton from its start state over the input from the offset on
+ * until it dies, keeping its state in a local variable. Returns the length
+ * of the longest match, or 0 if there is none, and sets final_state_tag to
+ * the tag of the final state it ended in.
+ *
+ * Once a state with a self loop has looped once, we jump straight to the end
+ * of the run of bytes it loops on. Waiting for the first loop keeps one byte
+ * lexemes like single letter identifiers off the SIMD path. Staying in one
+ * state does not change whether we have accepted, so only the match length
+ * needs to move along.
+ */
+std::size_t DeterministicFiniteAutomaton::find_longest_match(
+    std::string_view input, std::size_t offset, int* final_state_tag) const {
+  std::size_t match_length = 0;
+  *final_state_tag = -1;
+  auto state = start_state_;
+  for (auto idx = offset; idx < input.size(); ++idx) {
+    auto input_byte = static_cast<unsigned char>(input[idx]);
+    auto next_state = transition_table_[
+        state * number_of_classes_ + byte_classes_[input_byte]];
+    if (next_state == kDeadState) {
+      break;
+    }
+    if (next_state == state && self_loops_[state].number_of_ranges != 0) {
+      idx = find_self_loop_end(self_loops_[state], input, idx + 1) - 1;
+    }
+    state = next_state;
+    if (final_state_tags_[state] != -1) {
+      match_length = idx - offset + 1;
+      *final_state_tag = final_state_tags_[state];
+    }
   }
+  return match_length;
+}
 
-  adjacency_list_ = new_adjacency_list;
+/**
+ * Returns how many bytes past the end of its match find_longest_match reads
+ * at most, counting the byte the automaton dies on or the end of the input,
+ * or -1 if there is no bound. A match that fails reads at most that many
+ * bytes from the offset.
+ *
+ * After the last final state, the automaton only passes through states that
+ * are neither final nor dead. So we look for the longest path through those
+ * states that starts at a successor of a final state or at the start state.
+ * If such a path can run into a cycle, there is no bound.
+ */
+int DeterministicFiniteAutomaton::get_max_lookahead() const {
+  int number_of_states = final_state_tags_.size();
+  auto is_passed_through = [&](int state) {
+    return state != kDeadState && final_state_tags_[state] == -1;
+  };
+  // The number of states on the longest path from each state, or -1 while the
+  // state is on the stack of the search below.
+  std::vector<int> path_lengths(number_of_states, 0);
+  std::vector<bool> is_visited(number_of_states, false);
+  std::vector<std::pair<int, int>> stack;
+  auto get_path_length = [&](int first_state) {
+    if (is_visited[first_state])
+      return path_lengths[first_state];
+    is_visited[first_state] = true;
+    path_lengths[first_state] = -1;
+    stack.emplace_back(first_state, 0);
+    while (!stack.empty()) {
+      auto& [state, byte_class] = stack.back();
+      if (byte_class == number_of_classes_) {
+        auto path_length = 0;
+        for (auto idx = 0; idx < number_of_classes_; ++idx) {
+          auto next_state =
+              transition_table_[state * number_of_classes_ + idx];
+          if (is_passed_through(next_state))
+            path_length = std::max(path_length, path_lengths[next_state]);
+        }
+        path_lengths[state] = path_length + 1;
+        stack.pop_back();
+        continue;
+      }
+      auto next_state =
+          transition_table_[state * number_of_classes_ + byte_class++];
+      if (!is_passed_through(next_state))
+        continue;
+      if (!is_visited[next_state]) {
+        is_visited[next_state] = true;
+        path_lengths[next_state] = -1;
+        stack.emplace_back(next_state, 0);
+      } else if (path_lengths[next_state] == -1) {
+        stack.clear();
+        return -1;
+      }
+    }
+    return path_lengths[first_state];
+  };
+
+  auto max_path_length = 0;
+  auto update_max_path_length = [&](int state) {
+    if (max_path_length == -1 || !is_passed_through(state))
+      return;
+    auto path_length = get_path_length(state);
+    max_path_length =
+        path_length == -1 ? -1 : std::max(max_path_length, path_length);
+  };
+  update_max_path_length(start_state_);
+  for (auto state = 0; state < number_of_states; ++state) {
+    if (final_state_tags_[state] == -1)
+      continue;
+    for (auto byte_class = 0; byte_class < number_of_classes_; ++byte_class)
+      update_max_path_length(
+          transition_table_[state * number_of_classes_ + byte_class]);
+  }
+  return max_path_length == -1 ? -1 : max_path_length + 1;
 }
 
-void TransitionGraph::combine_with(const TransitionGraph& other_graph) {
-  auto first_adjacency_list = adjacency_list_;
-  auto second_adjacency_list = other_graph.adjacency_list_;
+bool is_in_self_loop(const SelfLoop& self_loop, unsigned char input_byte) {
+  for (auto idx = 0; idx < self_loop.number_of_ranges; ++idx) {
+    if (input_byte >= self_loop.range_starts[idx] &&
+        input_byte <= self_loop.range_ends[idx])
+      return true;
+  }
+  return false;
+}
 
-  auto combined_adjacency_list = first_adjacency_list;
-  combined_adjacency_list.insert(
-      std::begin(second_adjacency_list),
-      std::end(second_adjacency_list));
+/**
+ * Returns the index of the first byte at or after offset that the self loop
+ * does not cover, or the size of the input if it covers them all.
+ */
+std::size_t find_self_loop_end_scalar(
+    const SelfLoop& self_loop, std::string_view input, std::size_t offset) {
+  auto idx = offset;
+  while (idx < input.size() &&
+         is_in_self_loop(self_loop, static_cast<unsigned char>(input[idx])))
+    ++idx;
+  return idx;
+}
 
-  adjacency_list_ = combined_adjacency_list;
+/**
+ * Same as find_self_loop_end_scalar, but compares 32 bytes at a time with
+ * AVX2 or 16 at a time with SSE2 when the compiler targets them. A byte x is
+ * in the range [start, end] when x - start, as an unsigned byte, is at most
+ * end - start, which is what the saturating min / compare pair checks.
+ */
+std::size_t find_self_loop_end(
+    const SelfLoop& self_loop, std::string_view input, std::size_t offset) {
+  auto idx = offset;
+#if defined(__AVX2__)
+  constexpr std::size_t kVectorSize = 32;
+  __m256i range_starts[SelfLoop::kMaxNumberOfRanges];
+  __m256i range_widths[SelfLoop::kMaxNumberOfRanges];
+  for (auto range = 0; range < self_loop.number_of_ranges; ++range) {
+    range_starts[range] = _mm256_set1_epi8(
+        static_cast<char>(self_loop.range_starts[range]));
+    range_widths[range] = _mm256_set1_epi8(static_cast<char>(
+        self_loop.range_ends[range] - self_loop.range_starts[range]));
+  }
+  while (idx + kVectorSize <= input.size()) {
+    auto bytes = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(input.data() + idx));
+    auto is_in_loop = _mm256_setzero_si256();
+    for (auto range = 0; range < self_loop.number_of_ranges; ++range) {
+      auto offsets = _mm256_sub_epi8(bytes, range_starts[range]);
+      is_in_loop = _mm256_or_si256(is_in_loop, _mm256_cmpeq_epi8(
+          _mm256_min_epu8(offsets, range_widths[range]), offsets));
+    }
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(is_in_loop));
+    if (mask != 0xFFFFFFFFu)
+      return idx + __builtin_ctz(~mask);
+    idx += kVectorSize;
+  }
+#elif defined(__SSE2__)
+  constexpr std::size_t kVectorSize = 16;
+  __m128i range_starts[SelfLoop::kMaxNumberOfRanges];
+  __m128i range_widths[SelfLoop::kMaxNumberOfRanges];
+  for (auto range = 0; range < self_loop.number_of_ranges; ++range) {
+    range_starts[range] = _mm_set1_epi8(
+        static_cast<char>(self_loop.range_starts[range]));
+    range_widths[range] = _mm_set1_epi8(static_cast<char>(
+        self_loop.range_ends[range] - self_loop.range_starts[range]));
+  }
+  while (idx + kVectorSize <= input.size()) {
+    auto bytes = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(input.data() + idx));
+    auto is_in_loop = _mm_setzero_si128();
+    for (auto range = 0; range < self_loop.number_of_ranges; ++range) {
+      auto offsets = _mm_sub_epi8(bytes, range_starts[range]);
+      is_in_loop = _mm_or_si128(is_in_loop, _mm_cmpeq_epi8(
+          _mm_min_epu8(offsets, range_widths[range]), offsets));
+    }
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(is_in_loop));
+    if (mask != 0xFFFFu)
+      return idx + __builtin_ctz(~mask);
+    idx += kVectorSize;
+  }
+#endif
+  return find_self_loop_end_scalar(self_loop, input, idx);
 }
 
-TransitionGraphRow TransitionGraph::operator[](int state) {
-  return adjacency_list_[state];
+/**
+ * Minimize the automaton with Hopcroft's partition refinement. See
+ * minimize_dfa_tables.
+ */
+DeterministicFiniteAutomaton DeterministicFiniteAutomaton::minimize() const {
+  AutomatonTables tables;
+  tables.start_state = start_state_;
+  tables.number_of_classes = number_of_classes_;
+  std::copy(
+      std::begin(byte_classes_), std::end(byte_classes_),
+      std::begin(tables.byte_classes));
+  tables.transition_table.assign(
+      std::begin(transition_table_), std::end(transition_table_));
+  tables.final_state_tags.assign(
+      std::begin(final_state_tags_), std::end(final_state_tags_));
+  return DeterministicFiniteAutomaton(minimize_dfa_tables(tables));
 }
 
-void DeterministicFiniteAutomaton::move(const std::string &input_symbol) {
-  // There is only one next state for a state input pair.
+AutomatonCursor::AutomatonCursor(const DeterministicFiniteAutomaton& automaton)
+    :start_state_{automaton.get_start_state()},
+    number_of_classes_{automaton.get_number_of_classes()},
+    byte_classes_{automaton.get_byte_classes()},
+    transition_table_{automaton.get_transition_table()},
+    final_state_tags_{automaton.get_final_state_tags()},
+    current_state_{start_state_}
+{}
+
+void AutomatonCursor::move(char input_symbol) {
   if (!is_dead_) {
-    int next_state = -1;  // Default value. Used to mark "no state found".
-    for (auto state : graph_[current_state_][input_symbol])
-      // for loop to check if there is one or zero states for this state-input
-      // pair.
-      next_state = state;
-    current_state_ = next_state;
-
-    if (current_state_ == -1) {
+    auto input_byte = static_cast<unsigned char>(input_symbol);
+    current_state_ = transition_table_[
+        current_state_ * number_of_classes_ + byte_classes_[input_byte]];
+
+    if (current_state_ == DeterministicFiniteAutomaton::kDeadState) {
       is_dead_ = true;
       has_accepted_ = false;
     } else {
-      has_accepted_ = final_states_.find(current_state_) != final_states_.end();
+      has_accepted_ = final_state_tags_[current_state_] != -1;
     }
   }
 }
 
-void DeterministicFiniteAutomaton::reset() {
+void AutomatonCursor::move(const std::string& input_symbol) {
+  for (auto input_character : input_symbol)
+    move(input_character);
+}
+
+void AutomatonCursor::reset() {
   current_state_ = start_state_;
   is_dead_ = false;
   has_accepted_ = false;
 }
 
-bool DeterministicFiniteAutomaton::has_accepted() {
+bool AutomatonCursor::has_accepted() const {
   return has_accepted_;
 }
 
-bool DeterministicFiniteAutomaton::is_dead() {
+bool AutomatonCursor::is_dead() const {
   return is_dead_;
 }
 
-NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
-    const std::string& input_character) {
-  start_state_ = 0;
-  final_state_ = 1;
-  graph_.add_transition(0, 1, input_character);
-}
-
 /**
- * There was a choice of doing this algorithm with either BFS or DFS.
- * I chose DFS to workshop my recursion.
+ * Returns the tag of the final state the cursor is in, or -1 if it is not in
+ * a final state.
  */
-std::unordered_set<int> NonDeterministicFiniteAutomaton::compute_closure(
-    int state) {
-  if (closure_sets_.find(state) != closure_sets_.end()) {
-    return closure_sets_[state];
-  }
+int AutomatonCursor::get_final_state_tag() const {
+  if (!has_accepted_)
+    return -1;
+  return final_state_tags_[current_state_];
+}
 
-  std::unordered_set<int> closure_set = {state};
-  for (auto state_reachable_on_epsilon : graph_[state][""]) {
-    auto closure_set_of_next_state =
-        compute_closure(state_reachable_on_epsilon);
-    closure_set.insert(
-        std::begin(closure_set_of_next_state),
-        std::end(closure_set_of_next_state));
-  }
+int AutomatonCursor::get_current_state() const {
+  return current_state_;
+}
 
-  closure_sets_[state] = closure_set;
-  return closure_sets_[state];
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton()
+    :graph_{std::make_shared<TransitionGraph>()} {
+  start_state_ = graph_->add_state();
+  final_state_ = start_state_;
 }
 
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
+    const std::string& input_character)
+    :NonDeterministicFiniteAutomaton(
+        ByteSet(static_cast<unsigned char>(input_character[0])))
+{}
+
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
+    const ByteSet& input_bytes)
+    :NonDeterministicFiniteAutomaton(
+        std::make_shared<TransitionGraph>(), input_bytes)
+{}
+
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
+    std::shared_ptr<TransitionGraph> graph, const ByteSet& input_bytes)
+    :graph_{std::move(graph)} {
+  start_state_ = graph_->add_state();
+  final_state_ = graph_->add_state();
+  graph_->add_transition(start_state_, final_state_, input_bytes);
+}
+
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
+    std::shared_ptr<TransitionGraph> graph, int start_state, int final_state)
+    :graph_{std::move(graph)}, start_state_{start_state},
+    final_state_{final_state}
+{}
+
 /**
- * Compute the set of states that would become a DFA state for a DFA state -
- * input symbol pair.
+ * We build an automaton out of a list of alternatives using the following steps.
+ * 1. We bring the states of all alternatives into the graph of the first one.
+ * 2. We add epsilon transitions from a newly created start state to the start state of each
+ *    alternative.
+ * 3. We keep the final state of each alternative as a final state, tagged with the index of
+ *    the alternative.
  */
-std::unordered_set<int> NonDeterministicFiniteAutomaton::get_next_dfa_state(
-    const std::unordered_set<int>& current_dfa_state,
-    const std::string& transition_symbol) {
-  std::unordered_set<int> next_dfa_state;
-  for (auto state : current_dfa_state) {
-    for (auto next_nfa_state : graph_[state][transition_symbol]) {
-      auto closure_set = compute_closure(next_nfa_state);
-      std::set<int> sorted_next_dfa_state(
-          std::begin(next_dfa_state),
-          std::end(next_dfa_state));
-      std::set<int> sorted_closure_set(
-          std::begin(closure_set),
-          std::end(closure_set));
-      std::set_union(
-          sorted_next_dfa_state.begin(),
-          sorted_next_dfa_state.end(),
-          sorted_closure_set.begin(),
-          sorted_closure_set.end(),
-          std::inserter(sorted_next_dfa_state, sorted_next_dfa_state.begin()));
-      next_dfa_state = std::unordered_set<int>(
-          sorted_next_dfa_state.begin(),
-          sorted_next_dfa_state.end());
-    }
+NonDeterministicFiniteAutomaton::NonDeterministicFiniteAutomaton(
+    std::vector<NonDeterministicFiniteAutomaton> alternatives)
+    :graph_{alternatives.empty() ? std::make_shared<TransitionGraph>()
+                                 : alternatives[0].graph_} {
+  start_state_ = graph_->add_state();
+  final_state_ = start_state_;
+  for (std::size_t idx = 0; idx < alternatives.size(); ++idx) {
+    auto offset = adopt_states_of(alternatives[idx]);
+    graph_->add_transition(
+        start_state_, alternatives[idx].get_start_state() + offset);
+    // Merging this automaton with another one only keeps the final state
+    // of the last alternative.
+    final_state_ = alternatives[idx].get_final_state() + offset;
+    final_state_tags_[final_state_] = idx;
   }
-
-  return next_dfa_state;
 }
 
-void NonDeterministicFiniteAutomaton::increment_state_numbers(int number) {
-  start_state_ += number;
-  final_state_ += number;
-  graph_.increment_vertex_numbers(number);
+/**
+ * Returns the number to add to the states of the other automaton to get
+ * their numbers in the graph of this one. That is 0 if both share a graph.
+ * Otherwise the other graph is appended to this one first.
+ */
+int NonDeterministicFiniteAutomaton::adopt_states_of(
+    const NonDeterministicFiniteAutomaton& other_automaton) {
+  if (other_automaton.graph_ == graph_)
+    return 0;
+  return graph_->append(*other_automaton.graph_);
 }
 
 int NonDeterministicFiniteAutomaton::get_start_state() {
@@ -191,199 +436,96 @@ int NonDeterministicFiniteAutomaton::get_final_state() {
   return final_state_;
 }
 
+std::shared_ptr<TransitionGraph> NonDeterministicFiniteAutomaton::get_graph() {
+  return graph_;
+}
+
 /**
  * We merge with another automaton on union using the following steps.
- * 1. We increment first automaton's states by 1.
- * 2. We increment second automaton's states by the final state of the first automaton plus one.
- * 3. We merge both automaton's transition graphs. The increment steps were necessary to avoid duplicate states.
- * 4. We add epsilon transitions from a newly created start state to both automaton's start states.
- * 5. We add epsilon transitions from both automaton's final states to a newly created final state.
+ * 1. We bring the states of the other automaton into our graph, unless it already is in it.
+ * 2. We add epsilon transitions from a newly created start state to both automaton's start states.
+ * 3. We add epsilon transitions from both automaton's final states to a newly created final state.
  */
 void NonDeterministicFiniteAutomaton::merge_on_union(
     NonDeterministicFiniteAutomaton other_automaton) {
-  // Increment state numbers for both this automaton and the other automaton.
-  increment_state_numbers(1);
-  other_automaton.increment_state_numbers(get_final_state() + 1);
-
-  // Merge the transition graph of this automaton with the other
-  // automaton's transition graph.
-  auto combined_graph = graph_;
-  combined_graph.combine_with(other_automaton.graph_);
+  auto offset = adopt_states_of(other_automaton);
+  auto other_automaton_start_state = other_automaton.get_start_state() + offset;
+  auto other_automaton_final_state = other_automaton.get_final_state() + offset;
 
   // Add epsilon transitions from a newly created start state to both
   // automaton's start state.
-  auto new_start_state = 0;
-  auto this_automaton_start_state = get_start_state();
-  auto other_automaton_start_state = other_automaton.get_start_state();
-  combined_graph.add_transition(
-      new_start_state, this_automaton_start_state, "");
-  combined_graph.add_transition(
-      new_start_state, other_automaton_start_state, "");
+  auto new_start_state = graph_->add_state();
+  graph_->add_transition(new_start_state, start_state_);
+  graph_->add_transition(new_start_state, other_automaton_start_state);
 
   // Add epsilon transitions from both automaton's final states to a newly
   // created final state.
-  auto this_automaton_final_state = get_final_state();
-  auto other_automaton_final_state = other_automaton.get_final_state();
-  auto new_final_state = other_automaton_final_state + 1;
-  combined_graph.add_transition(
-      this_automaton_final_state, new_final_state, "");
-  combined_graph.add_transition(
-      other_automaton_final_state, new_final_state, "");
-
-  // Finally, update the attributes of this automaton
-  // with the combined automaton's attributes.
+  auto new_final_state = graph_->add_state();
+  graph_->add_transition(final_state_, new_final_state);
+  graph_->add_transition(other_automaton_final_state, new_final_state);
+
   start_state_ = new_start_state;
   final_state_ = new_final_state;
-  graph_ = combined_graph;
 }
 
 /**
  * We merge with other automaton on concatenation using the following steps.
- * 1. We increment the other automaton's states by the final state of the first automaton plus one.
+ * 1. We bring the states of the other automaton into our graph, unless it already is in it.
  * 2. We add an epsilon transition from the final state of the first automaton to the start state of
  *    the second automaton.
- * 3. We make the start state of the first automaton the start state of the new automaton.
- * 4. We make the final state of the second automaton the final state of the new automaton.
+ * 3. We make the final state of the second automaton the final state of the new automaton.
  */
 void NonDeterministicFiniteAutomaton::merge_on_concatenation(
     NonDeterministicFiniteAutomaton other_automaton) {
-  // Increment state numbers of the other automaton.
-  auto this_automaton_final_state = get_final_state();
-  other_automaton.increment_state_numbers(this_automaton_final_state + 1);
-
-  // Merge the transition graph of this automaton
-  // with other automaton's transition graph.
-  auto combined_graph = graph_;
-  combined_graph.combine_with(other_automaton.graph_);
-
-  // Add an epsilon transition from the final state of the first automaton
-  // to the start state of the second automaton.
-  auto other_automaton_start_state = other_automaton.get_start_state();
-  combined_graph.add_transition(
-      this_automaton_final_state, other_automaton_start_state, "");
-
-  // Finally, update the attributes of this automaton
-  // with the combined automaton's attributes.
-  auto this_automaton_start_state = get_start_state();
-  auto other_automaton_final_state = other_automaton.get_final_state();
-  start_state_ = this_automaton_start_state;
-  final_state_ = other_automaton_final_state;
-  graph_ = combined_graph;
+  auto offset = adopt_states_of(other_automaton);
+  graph_->add_transition(
+      final_state_, other_automaton.get_start_state() + offset);
+  final_state_ = other_automaton.get_final_state() + offset;
 }
 
 /**
  * We apply kleene star to an automaton using the following steps.
- * 1. We increment the states by 1.
- * 2. We introduce a new start state 0 and add an epsilon transition from the new start state to the
- *    old start state.
- * 3. We introduce a new final state <final_state_ + 1> and add an epsilon transition from the old
- *    final state to the the new final state.
- * 4. We add an epsilon transition from the old final state to the old start state.
- * 5. We add an epsilon transition from the new start state to the new final state.
+ * 1. We introduce a new start state and add an epsilon transition from it to the old start state.
+ * 2. We introduce a new final state and add an epsilon transition from the old final state to it.
+ * 3. We add an epsilon transition from the old final state to the old start state.
+ * 4. We add an epsilon transition from the new start state to the new final state.
  */
 void NonDeterministicFiniteAutomaton::apply_star() {
-  // Increment states by 1.
-  increment_state_numbers(1);
-
-  // Create a new start state and add an epsilon transition
-  // from the new start state to the old start state.
   auto old_start_state = start_state_;
-  auto new_start_state = 0;
-  start_state_ = new_start_state;
-  graph_.add_transition(new_start_state, old_start_state, "");
+  auto old_final_state = final_state_;
+  auto new_start_state = graph_->add_state();
+  auto new_final_state = graph_->add_state();
 
-  // Create a new final state and add an epsilon transition
-  // from the old final state to the new final state.
-  auto old_final_state = get_final_state();
-  auto new_final_state = old_final_state + 1;
-  final_state_ = new_final_state;
-  graph_.add_transition(old_final_state, new_final_state, "");
+  graph_->add_transition(new_start_state, old_start_state);
+  graph_->add_transition(old_final_state, new_final_state);
+  graph_->add_transition(old_final_state, old_start_state);
+  graph_->add_transition(new_start_state, new_final_state);
 
-  // Add an epsilon transition from the old final state to the old start state.
-  graph_.add_transition(old_final_state, old_start_state, "");
-  // Add an epsilon transition from the new start state to the final state.
-  graph_.add_transition(new_start_state, new_final_state, "");
-
-  // Finally, update the attributes of this automaton
-  // with the combined automaton's attributes.
-  // The graph is already updated above.
   start_state_ = new_start_state;
   final_state_ = new_final_state;
 }
 
 /**
- * Convert an NFA into a DFA using breadth first search.
+ * Returns the tag of each state of the graph, or -1 for states that are not
+ * final. An automaton that was not built from a list of alternatives has one
+ * final state, tagged 0.
  */
-DeterministicFiniteAutomaton NonDeterministicFiniteAutomaton::convert_to_dfa() {
-  // Doubles as a set of seen states
-  // and to assign state numbers to new DFA states.
-  std::vector<std::unordered_set<int>> seen_states;
-  // queue for BFS.
-  std::deque<std::unordered_set<int>> queue;
-  // New DFS graph.
-  TransitionGraph dfa_graph;
-
-  // Start by computing the start state of the new DFA and inserting it into
-  // the seen set and the queue.
-  auto dfa_start_state = compute_closure(start_state_);
-  seen_states.push_back(dfa_start_state);
-  queue.push_back(dfa_start_state);
-
-  // Do the BFS.
-  while (!queue.empty()) {
-    auto current_dfa_state = queue.front();
-    queue.pop_front();
-    auto current_dfa_state_number = std::distance(
-        std::begin(seen_states),
-        std::find(
-            std::begin(seen_states),
-            std::end(seen_states),
-            current_dfa_state));
-    for (auto state : current_dfa_state) {
-      auto adjacency_list_row = graph_[state];
-      for (const auto& transition_symbol :
-           adjacency_list_row.get_non_epsilon_transitions()) {
-        auto next_dfa_state = get_next_dfa_state(
-            current_dfa_state, transition_symbol);
-        if (std::find(
-            std::begin(seen_states),
-            std::end(seen_states),
-            next_dfa_state) == std::end(seen_states)) {
-          seen_states.push_back(next_dfa_state);
-          queue.push_back(next_dfa_state);
-        }
-        auto next_dfa_state_number = std::distance(
-            std::begin(seen_states),
-            std::find(
-                std::begin(seen_states),
-                std::end(seen_states),
-                next_dfa_state));
-        dfa_graph.add_transition(
-            current_dfa_state_number, next_dfa_state_number, transition_symbol);
-      }
-    }
-  }
-
-  int dfa_start_state_number {0};
-  std::unordered_set<int> dfa_final_state_numbers;
-  for (auto dfa_state : seen_states) {
-    if (std::find(
-        std::begin(dfa_state),
-        std::end(dfa_state),
-        final_state_) != std::end(dfa_state)) {
-      auto dfa_state_number = std::distance(
-          std::begin(seen_states),
-          std::find(
-              std::begin(seen_states),
-              std::end(seen_states),
-              dfa_state));
-      dfa_final_state_numbers.insert(dfa_state_number);
-    }
+std::vector<int> NonDeterministicFiniteAutomaton::get_final_state_tags() {
+  std::vector<int> final_state_tags(graph_->get_number_of_states(), -1);
+  if (final_state_tags_.empty()) {
+    final_state_tags[final_state_] = 0;
   }
+  for (const auto& state_tag_pair : final_state_tags_)
+    final_state_tags[state_tag_pair.first] = state_tag_pair.second;
+  return final_state_tags;
+}
 
-  DeterministicFiniteAutomaton automaton(
-      dfa_start_state_number, dfa_final_state_numbers, dfa_graph);
-  return automaton;
+/**
+ * Convert an NFA into a DFA using breadth first search. See build_dfa_tables.
+ */
+DeterministicFiniteAutomaton NonDeterministicFiniteAutomaton::convert_to_dfa() {
+  return DeterministicFiniteAutomaton(
+      build_dfa_tables(*graph_, start_state_, get_final_state_tags()));
 }
 
 }  // namespace tokenizer
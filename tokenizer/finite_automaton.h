@@ -1,46 +1,259 @@
 #ifndef TOKENIZER_FINITE_AUTOMATON_H_
 #define TOKENIZER_FINITE_AUTOMATON_H_
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace tokenizer {
 
 /**
- * Represents an adjacency list row.
+ * A set of input bytes. NFA transitions are labeled with one, so a character
+ * class is a single transition rather than a union with a branch per byte.
  */
-class TransitionGraphRow {
+class ByteSet {
  private:
-  std::unordered_map<std::string, std::unordered_set<int>> adjacency_list_row_;
+  std::array<std::uint64_t, 4> words_{};
 
  public:
-  TransitionGraphRow() = default;
-  ~TransitionGraphRow() = default;
+  constexpr ByteSet() = default;
+  constexpr explicit ByteSet(unsigned char input_byte) {
+    insert(input_byte);
+  }
+  ~ByteSet() = default;
 
-  void add_input_state_pair(const std::string& input_symbol, int state);
-  void increment_values(int number);
-  std::unordered_set<std::string> get_non_epsilon_transitions();
-  std::unordered_set<int> operator[](const std::string& input);
+  constexpr void insert(unsigned char input_byte) {
+    words_[input_byte / 64] |= std::uint64_t{1} << (input_byte % 64);
+  }
+  constexpr void insert_range(unsigned char first_byte, unsigned char last_byte) {
+    for (auto input_byte = first_byte; input_byte <= last_byte; ++input_byte) {
+      insert(input_byte);
+      if (input_byte == 255)
+        break;
+    }
+  }
+  constexpr void insert_all(const ByteSet& other) {
+    for (auto idx = 0; idx < 4; ++idx)
+      words_[idx] |= other.words_[idx];
+  }
+  constexpr bool contains(unsigned char input_byte) const {
+    return words_[input_byte / 64] >> (input_byte % 64) & 1;
+  }
+  constexpr bool is_empty() const {
+    return (words_[0] | words_[1] | words_[2] | words_[3]) == 0;
+  }
+  constexpr ByteSet complement() const {
+    ByteSet complement_set;
+    for (auto idx = 0; idx < 4; ++idx)
+      complement_set.words_[idx] = ~words_[idx];
+    return complement_set;
+  }
+  constexpr bool operator==(const ByteSet& other) const = default;
 };
 
 /**
- * Adjacency list representation of transition graph.
+ * An arena of NFA states. States are numbered in the order they are added
+ * and are never renumbered, and transitions are kept in two flat arrays of
+ * edges. Thompson fragments built in one graph are combined by adding
+ * states and edges, without touching the states already there.
+ *
+ * Everything is constexpr, so the compile-time lexer of static_lexer.h
+ * builds its NFA in the same graph.
  */
 class TransitionGraph {
+ public:
+  struct EpsilonTransition {
+    int start_state;
+    int end_state;
+  };
+  struct ByteSetTransition {
+    int start_state;
+    int end_state;
+    ByteSet input_bytes;
+  };
+
  private:
-  std::unordered_map<int, TransitionGraphRow> adjacency_list_;
+  int number_of_states_ = 0;
+  std::vector<EpsilonTransition> epsilon_transitions_;
+  std::vector<ByteSetTransition> byte_set_transitions_;
 
  public:
-  TransitionGraph() = default;
-  ~TransitionGraph() = default;
-
-  void add_transition(
-      int start_state, int end_state, const std::string& input_symbol);
-  void increment_vertex_numbers(int number);
-  void combine_with(const TransitionGraph& other_graph);
-  TransitionGraphRow operator[](int state);
+  constexpr TransitionGraph() = default;
+  constexpr ~TransitionGraph() = default;
+
+  constexpr int add_state() {
+    return number_of_states_++;
+  }
+  constexpr void add_transition(int start_state, int end_state) {
+    epsilon_transitions_.push_back({start_state, end_state});
+  }
+  constexpr void add_transition(
+      int start_state, int end_state, const ByteSet& input_bytes) {
+    byte_set_transitions_.push_back({start_state, end_state, input_bytes});
+  }
+  /**
+   * An empty input symbol adds an epsilon transition. Otherwise the symbol
+   * is a single character.
+   */
+  constexpr void add_transition(
+      int start_state, int end_state, std::string_view input_symbol) {
+    if (input_symbol.empty()) {
+      add_transition(start_state, end_state);
+    } else {
+      add_transition(
+          start_state, end_state,
+          ByteSet(static_cast<unsigned char>(input_symbol[0])));
+    }
+  }
+
+  /**
+   * Copies the states and transitions of another graph after the states of
+   * this one, and returns the number the first of them got.
+   */
+  constexpr int append(const TransitionGraph& other_graph) {
+    auto offset = number_of_states_;
+    number_of_states_ += other_graph.number_of_states_;
+    for (const auto& transition : other_graph.epsilon_transitions_)
+      add_transition(
+          transition.start_state + offset, transition.end_state + offset);
+    for (const auto& transition : other_graph.byte_set_transitions_)
+      add_transition(
+          transition.start_state + offset, transition.end_state + offset,
+          transition.input_bytes);
+    return offset;
+  }
+
+  constexpr int get_number_of_states() const {
+    return number_of_states_;
+  }
+  constexpr const std::vector<EpsilonTransition>&
+      get_epsilon_transitions() const {
+    return epsilon_transitions_;
+  }
+  constexpr const std::vector<ByteSetTransition>&
+      get_byte_set_transitions() const {
+    return byte_set_transitions_;
+  }
+
+  /**
+   * The epsilon transitions grouped by start state, in the order they were
+   * added.
+   */
+  constexpr std::vector<std::vector<int>> get_epsilon_adjacency_lists() const {
+    std::vector<std::vector<int>> adjacency_lists(number_of_states_);
+    for (const auto& transition : epsilon_transitions_)
+      adjacency_lists[transition.start_state].push_back(transition.end_state);
+    return adjacency_lists;
+  }
+};
+
+/**
+ * The bytes on which a DFA state moves to itself, as a few inclusive byte
+ * ranges. A run of such bytes, like the body of an identifier or a number,
+ * can be skipped many bytes at a time with SIMD compares instead of a table
+ * lookup per byte. States whose loop needs more ranges are not marked.
+ */
+struct SelfLoop {
+  static constexpr int kMaxNumberOfRanges = 4;
+
+  int number_of_ranges = 0;
+  unsigned char range_starts[kMaxNumberOfRanges] = {};
+  unsigned char range_ends[kMaxNumberOfRanges] = {};
+};
+
+/**
+ * Returns the self loop of a state of a transition table with one row per
+ * state and one column per byte class, or an unmarked SelfLoop if the state
+ * moves to itself on more than SelfLoop::kMaxNumberOfRanges ranges of bytes.
+ */
+constexpr SelfLoop find_self_loop(
+    int state, int number_of_classes, std::span<const std::uint8_t> byte_classes,
+    std::span<const int> transition_table) {
+  SelfLoop self_loop;
+  auto is_in_range = false;
+  for (auto symbol = 0; symbol < 256; ++symbol) {
+    auto loops = transition_table[
+        state * number_of_classes + byte_classes[symbol]] == state;
+    if (loops && !is_in_range) {
+      if (self_loop.number_of_ranges == SelfLoop::kMaxNumberOfRanges)
+        return SelfLoop();
+      self_loop.range_starts[self_loop.number_of_ranges++] = symbol;
+    }
+    if (loops)
+      self_loop.range_ends[self_loop.number_of_ranges - 1] = symbol;
+    is_in_range = loops;
+  }
+  return self_loop;
+}
+
+bool is_in_self_loop(const SelfLoop& self_loop, unsigned char input_byte);
+std::size_t find_self_loop_end(
+    const SelfLoop& self_loop, std::string_view input, std::size_t offset);
+std::size_t find_self_loop_end_scalar(
+    const SelfLoop& self_loop, std::string_view input, std::size_t offset);
+
+/**
+ * Maps each byte to its equivalence class. Bytes in one class are never told
+ * apart by any transition, like all lowercase letters in a lexer where every
+ * pattern that mentions one mentions them all.
+ */
+using ByteClasses = std::array<std::uint8_t, 256>;
+
+/**
+ * Partition the bytes into the coarsest classes such that each byte set is a
+ * union of classes, and store the class of each byte in byte_classes. Classes
+ * are numbered in the order of their smallest byte. Returns the number of
+ * classes.
+ *
+ * We refine one byte set at a time. Every class splits into the bytes inside
+ * the set and the bytes outside it, and the new class of a byte only depends
+ * on its old class and on which side it is.
+ */
+constexpr int compute_byte_classes(
+    const std::vector<ByteSet>& byte_sets, ByteClasses* byte_classes) {
+  byte_classes->fill(0);
+  auto number_of_classes = 1;
+  std::vector<int> refined_classes;
+  for (const auto& byte_set : byte_sets) {
+    refined_classes.assign(2 * 256, -1);
+    auto number_of_refined_classes = 0;
+    for (auto symbol = 0; symbol < 256; ++symbol) {
+      auto& refined_class = refined_classes[
+          2 * (*byte_classes)[symbol] + byte_set.contains(symbol)];
+      if (refined_class == -1)
+        refined_class = number_of_refined_classes++;
+      (*byte_classes)[symbol] = refined_class;
+    }
+    number_of_classes = number_of_refined_classes;
+  }
+  return number_of_classes;
+}
+
+/**
+ * The tables of a DFA as vectors, before they are handed to a
+ * DeterministicFiniteAutomaton. See build_dfa_tables and minimize_dfa_tables.
+ */
+struct AutomatonTables {
+  int start_state = 0;
+  int number_of_classes = 1;
+  ByteClasses byte_classes{};
+  // One row of number_of_classes entries per state.
+  std::vector<int> transition_table;
+  // -1 for states that are not final.
+  std::vector<int> final_state_tags;
+
+  constexpr int get_number_of_states() const {
+    return final_state_tags.size();
+  }
 };
 
 /**
@@ -49,59 +262,551 @@ class TransitionGraph {
  * 2. A set of states designated as a final state.
  * 3. A transition function that maps a state and a transition symbol to a
  *    state.
+ *
+ * The transition function is stored as a dense table with one row per state
+ * and one column per byte class, so moving on a byte is a class lookup and a
+ * single indexed load. Missing transitions point to kDeadState.
+ *
+ * Each final state also carries a tag. An automaton built from several
+ * alternatives uses it to tell which alternative a final state accepts for.
+ * States that are not final have the tag -1.
+ *
+ * States that loop back to themselves on a few ranges of bytes are marked
+ * with a SelfLoop when the automaton is built, and find_longest_match skips
+ * over runs of those bytes with find_self_loop_end.
+ *
+ * The tables are immutable once built and are only referred to through
+ * spans. An automaton built at run time owns them through storage_, so
+ * copies share one set of tables. An automaton can also point at tables it
+ * does not build itself, like constants computed at compile time or a file
+ * mapped into memory, with storage_ keeping the mapping alive.
+ *
+ * The automaton itself has no current state either, so one automaton can be
+ * used from any number of threads at once. Moving through it a byte at a
+ * time is done with an AutomatonCursor.
  */
 class DeterministicFiniteAutomaton {
+ public:
+  static constexpr int kNumberOfSymbols = 256;
+  static constexpr int kDeadState = -1;
+
  private:
+  struct Tables {
+    ByteClasses byte_classes;
+    std::vector<int> transition_table;
+    std::vector<int> final_state_tags;
+    std::vector<SelfLoop> self_loops;
+  };
+
+  std::shared_ptr<const void> storage_;
   int start_state_{};
-  std::unordered_set<int> final_states_;
-  int current_state_{};
-  TransitionGraph graph_;
-  bool has_accepted_ = false;
-  bool is_dead_ = false;
+  int number_of_classes_ = 1;
+  std::span<const std::uint8_t> byte_classes_;
+  std::span<const int> transition_table_;
+  std::span<const int> final_state_tags_;
+  std::span<const SelfLoop> self_loops_;
 
  public:
-  DeterministicFiniteAutomaton() = default;
+  DeterministicFiniteAutomaton();
+  explicit DeterministicFiniteAutomaton(AutomatonTables tables);
   DeterministicFiniteAutomaton(
-      int start_state, std::unordered_set<int> final_states,
-      const TransitionGraph& graph)
-      :start_state_{start_state}, final_states_{std::move(final_states)},
-      current_state_{start_state}, graph_{graph}
-  {}
+      std::shared_ptr<const void> storage, int start_state,
+      int number_of_classes, std::span<const std::uint8_t> byte_classes,
+      std::span<const int> transition_table,
+      std::span<const int> final_state_tags,
+      std::span<const SelfLoop> self_loops);
   ~DeterministicFiniteAutomaton() = default;
 
+  int get_number_of_states() const;
+  int get_number_of_classes() const;
+  int get_byte_class(unsigned char input_byte) const;
+  SelfLoop get_self_loop(int state) const;
+  int get_start_state() const;
+  std::span<const std::uint8_t> get_byte_classes() const;
+  std::span<const int> get_transition_table() const;
+  std::span<const int> get_final_state_tags() const;
+  std::span<const SelfLoop> get_self_loops() const;
+  std::size_t find_longest_match(
+      std::string_view input, std::size_t offset, int* final_state_tag) const;
+  int get_max_lookahead() const;
+  DeterministicFiniteAutomaton minimize() const;
+};
+
+/**
+ * A position in a DeterministicFiniteAutomaton, moved a byte at a time. A
+ * cursor only holds its state and views of the tables of its automaton, so
+ * it is cheap to create one per thread or per input. Like a Token, it does
+ * not own what it points into, and the automaton has to outlive it.
+ */
+class AutomatonCursor {
+ private:
+  int start_state_;
+  int number_of_classes_;
+  std::span<const std::uint8_t> byte_classes_;
+  std::span<const int> transition_table_;
+  std::span<const int> final_state_tags_;
+  int current_state_;
+  bool has_accepted_ = false;
+  bool is_dead_ = false;
+
+ public:
+  explicit AutomatonCursor(const DeterministicFiniteAutomaton& automaton);
+  ~AutomatonCursor() = default;
+
+  void move(char input_symbol);
   void move(const std::string& input_symbol);
   void reset();
-  bool has_accepted();
-  bool is_dead();
+  bool has_accepted() const;
+  bool is_dead() const;
+  int get_final_state_tag() const;
+  int get_current_state() const;
 };
 
+/**
+ * A set of NFA states, stored as one bit per state.
+ */
+using StateSet = std::vector<std::uint64_t>;
+
+/**
+ * FNV-1a over the words of the bitset.
+ */
+constexpr std::uint64_t hash_state_set(const StateSet& state_set) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (auto word : state_set) {
+    hash ^= word;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Compute the epsilon closure of every state as a bitset. We walk the
+ * epsilon edges from each state with an explicit stack, so deep chains of
+ * epsilon transitions do not recurse.
+ */
+constexpr std::vector<StateSet> compute_closure_sets(
+    const std::vector<std::vector<int>>& epsilon_transitions) {
+  int number_of_states = epsilon_transitions.size();
+  auto number_of_words = (number_of_states + 63) / 64;
+  std::vector<StateSet> closure_sets(
+      number_of_states, StateSet(number_of_words, 0));
+
+  std::vector<int> stack;
+  for (auto state = 0; state < number_of_states; ++state) {
+    auto& closure_set = closure_sets[state];
+    stack.push_back(state);
+    closure_set[state / 64] |= std::uint64_t{1} << (state % 64);
+    while (!stack.empty()) {
+      auto reached_state = stack.back();
+      stack.pop_back();
+      for (auto next_state : epsilon_transitions[reached_state]) {
+        auto bit = std::uint64_t{1} << (next_state % 64);
+        if (!(closure_set[next_state / 64] & bit)) {
+          closure_set[next_state / 64] |= bit;
+          stack.push_back(next_state);
+        }
+      }
+    }
+  }
+
+  return closure_sets;
+}
+
+/**
+ * Convert the NFA of a graph, from a start state and with a tag per final
+ * state, into a DFA using breadth first search.
+ *
+ * A DFA state is a bitset over the states of the graph. Epsilon closures
+ * are computed once up front, and the state numbers of discovered DFA
+ * states are looked up in an open addressing table by the hash of their
+ * bitsets. The transition table of the DFA is filled in as its states are
+ * discovered. States of the graph the start state cannot reach are never
+ * visited.
+ *
+ * Bytes are first grouped into the classes the transitions of the NFA cannot
+ * tell apart, and the DFA moves on classes, so a transition on [a-z] is
+ * followed once rather than 26 times.
+ *
+ * Everything is constexpr, so the compile-time lexer of static_lexer.h
+ * builds its tables with the same code as NonDeterministicFiniteAutomaton::
+ * convert_to_dfa.
+ */
+constexpr AutomatonTables build_dfa_tables(
+    const TransitionGraph& graph, int start_state,
+    const std::vector<int>& nfa_final_state_tags) {
+  constexpr auto kDeadState = -1;
+  auto number_of_states = graph.get_number_of_states();
+  auto number_of_words = (number_of_states + 63) / 64;
+
+  // Replace the byte set on each transition by the byte classes it covers,
+  // and group the transitions by start state.
+  AutomatonTables tables;
+  const auto& byte_set_transitions = graph.get_byte_set_transitions();
+  std::vector<ByteSet> byte_sets;
+  for (const auto& transition : byte_set_transitions)
+    byte_sets.push_back(transition.input_bytes);
+  tables.number_of_classes =
+      compute_byte_classes(byte_sets, &tables.byte_classes);
+  auto number_of_classes = tables.number_of_classes;
+  std::vector<std::vector<std::pair<int, int>>> class_transitions(
+      number_of_states);
+  std::vector<bool> is_class_covered(number_of_classes);
+  for (const auto& transition : byte_set_transitions) {
+    std::fill(std::begin(is_class_covered), std::end(is_class_covered), false);
+    for (auto symbol = 0; symbol < 256; ++symbol) {
+      auto byte_class = tables.byte_classes[symbol];
+      if (transition.input_bytes.contains(symbol) &&
+          !is_class_covered[byte_class]) {
+        is_class_covered[byte_class] = true;
+        class_transitions[transition.start_state].emplace_back(
+            byte_class, transition.end_state);
+      }
+    }
+  }
+  auto closure_sets = compute_closure_sets(
+      graph.get_epsilon_adjacency_lists());
+
+  // Doubles as a set of seen states and to assign state numbers to new DFA
+  // states. Since states are numbered in the order they are seen, walking
+  // seen_states in order is the BFS.
+  std::vector<StateSet> seen_states;
+  // The number of the seen state hashed to each slot, or -1. Kept at most
+  // half full, so probes are short.
+  std::vector<int> dfa_state_slots(16, -1);
+  auto find_slot = [&](const StateSet& dfa_state) {
+    std::size_t slot_mask = dfa_state_slots.size() - 1;
+    std::size_t slot = hash_state_set(dfa_state) & slot_mask;
+    while (dfa_state_slots[slot] != -1 &&
+           seen_states[dfa_state_slots[slot]] != dfa_state)
+      slot = (slot + 1) & slot_mask;
+    return slot;
+  };
+
+  auto add_dfa_state = [&](const StateSet& dfa_state) {
+    auto slot = find_slot(dfa_state);
+    if (dfa_state_slots[slot] != -1)
+      return dfa_state_slots[slot];
+
+    int new_dfa_state_number = seen_states.size();
+    seen_states.push_back(dfa_state);
+    dfa_state_slots[slot] = new_dfa_state_number;
+    if (2 * seen_states.size() > dfa_state_slots.size()) {
+      dfa_state_slots.assign(2 * dfa_state_slots.size(), -1);
+      for (std::size_t idx = 0; idx < seen_states.size(); ++idx)
+        dfa_state_slots[find_slot(seen_states[idx])] = idx;
+    }
+    tables.transition_table.resize(
+        tables.transition_table.size() + number_of_classes, kDeadState);
+
+    // A DFA state is final if it contains a final NFA state. If it contains
+    // several, the one with the lowest tag wins.
+    auto dfa_final_state_tag = -1;
+    for (auto word_idx = 0; word_idx < number_of_words; ++word_idx) {
+      for (auto word = dfa_state[word_idx]; word != 0; word &= word - 1) {
+        auto state = word_idx * 64 + std::countr_zero(word);
+        auto final_state_tag = nfa_final_state_tags[state];
+        if (final_state_tag != -1 &&
+            (dfa_final_state_tag == -1 ||
+             final_state_tag < dfa_final_state_tag)) {
+          dfa_final_state_tag = final_state_tag;
+        }
+      }
+    }
+    tables.final_state_tags.push_back(dfa_final_state_tag);
+    return new_dfa_state_number;
+  };
+
+  // Union of the closures of the states reached on each byte class from the
+  // current DFA state. Only the rows of touched classes are cleared again.
+  std::vector<StateSet> next_dfa_states(
+      number_of_classes, StateSet(number_of_words, 0));
+  std::vector<bool> is_class_touched(number_of_classes, false);
+  std::vector<int> touched_classes;
+
+  add_dfa_state(closure_sets[start_state]);
+  for (std::size_t current_dfa_state_number = 0;
+       current_dfa_state_number < seen_states.size();
+       ++current_dfa_state_number) {
+    const auto current_dfa_state = seen_states[current_dfa_state_number];
+    for (auto word_idx = 0; word_idx < number_of_words; ++word_idx) {
+      for (auto word = current_dfa_state[word_idx]; word != 0;
+           word &= word - 1) {
+        auto state = word_idx * 64 + std::countr_zero(word);
+        for (const auto& class_state_pair : class_transitions[state]) {
+          auto byte_class = class_state_pair.first;
+          auto& next_dfa_state = next_dfa_states[byte_class];
+          const auto& closure_set = closure_sets[class_state_pair.second];
+          for (auto idx = 0; idx < number_of_words; ++idx)
+            next_dfa_state[idx] |= closure_set[idx];
+          if (!is_class_touched[byte_class]) {
+            is_class_touched[byte_class] = true;
+            touched_classes.push_back(byte_class);
+          }
+        }
+      }
+    }
+
+    for (auto byte_class : touched_classes) {
+      auto& next_dfa_state = next_dfa_states[byte_class];
+      auto next_dfa_state_number = add_dfa_state(next_dfa_state);
+      tables.transition_table[
+          current_dfa_state_number * number_of_classes + byte_class] =
+          next_dfa_state_number;
+      std::fill(std::begin(next_dfa_state), std::end(next_dfa_state), 0);
+      is_class_touched[byte_class] = false;
+    }
+    touched_classes.clear();
+  }
+  return tables;
+}
+
+/**
+ * Minimize the tables of a DFA with Hopcroft's partition refinement.
+ *
+ * We complete the automaton with an explicit sink state standing in for the
+ * dead state and start from a partition that groups states by their final
+ * state tag, so states accepting for different alternatives never merge.
+ * Each block taken off the worklist splits every block that has some, but not
+ * all, of its states moving into it on some byte class. Of the two halves, only
+ * the smaller one needs to go back on the worklist unless the block being
+ * split is already on it.
+ *
+ * States are kept in one array ordered by block, so splitting a block only
+ * touches the states that move into the splitter.
+ *
+ * Like build_dfa_tables, this is constexpr and shared by
+ * DeterministicFiniteAutomaton::minimize and static_lexer.h.
+ */
+constexpr AutomatonTables minimize_dfa_tables(const AutomatonTables& tables) {
+  constexpr auto kDeadState = -1;
+  auto number_of_states = tables.get_number_of_states();
+  auto number_of_classes = tables.number_of_classes;
+  auto sink_state = number_of_states;
+  auto number_of_completed_states = number_of_states + 1;
+  auto next_state = [&](int state, int byte_class) {
+    if (state == sink_state)
+      return sink_state;
+    auto state_on_symbol =
+        tables.transition_table[state * number_of_classes + byte_class];
+    return state_on_symbol == kDeadState ? sink_state : state_on_symbol;
+  };
+
+  // Inverse transitions, grouped by byte class and then by target state.
+  std::vector<int> predecessor_starts(
+      number_of_classes * (number_of_completed_states + 1), 0);
+  std::vector<int> predecessors(
+      number_of_classes * number_of_completed_states);
+  for (auto byte_class = 0; byte_class < number_of_classes; ++byte_class) {
+    auto* starts =
+        &predecessor_starts[byte_class * (number_of_completed_states + 1)];
+    for (auto state = 0; state < number_of_completed_states; ++state)
+      ++starts[next_state(state, byte_class) + 1];
+    for (auto state = 0; state < number_of_completed_states; ++state)
+      starts[state + 1] += starts[state];
+    std::vector<int> fill(starts, starts + number_of_completed_states);
+    for (auto state = 0; state < number_of_completed_states; ++state) {
+      auto target = next_state(state, byte_class);
+      predecessors[byte_class * number_of_completed_states + fill[target]++] =
+          state;
+    }
+  }
+
+  // The initial partition groups states by tag. Non final states, including
+  // the sink state, share the tag -1. Tags are small, so the block of each
+  // tag is looked up by tag + 1.
+  std::vector<int> states(number_of_completed_states);
+  std::vector<int> state_locations(number_of_completed_states);
+  std::vector<int> block_of_state(number_of_completed_states);
+  std::vector<int> block_starts;
+  std::vector<int> block_ends;
+  std::vector<int> state_tags(number_of_completed_states, -1);
+  auto max_tag = -1;
+  for (auto state = 0; state < number_of_states; ++state) {
+    state_tags[state] = tables.final_state_tags[state];
+    max_tag = std::max(max_tag, state_tags[state]);
+  }
+  std::vector<int> block_of_tag(max_tag + 2, -1);
+  std::vector<int> block_sizes;
+  for (auto state = 0; state < number_of_completed_states; ++state) {
+    auto& tag_block = block_of_tag[state_tags[state] + 1];
+    if (tag_block == -1) {
+      tag_block = block_sizes.size();
+      block_sizes.push_back(0);
+    }
+    block_of_state[state] = tag_block;
+    ++block_sizes[tag_block];
+  }
+  auto next_block_start = 0;
+  for (auto block_size : block_sizes) {
+    block_starts.push_back(next_block_start);
+    block_ends.push_back(next_block_start);
+    next_block_start += block_size;
+  }
+  for (auto state = 0; state < number_of_completed_states; ++state) {
+    auto block = block_of_state[state];
+    states[block_ends[block]] = state;
+    state_locations[state] = block_ends[block]++;
+  }
+
+  // A queue, with the blocks before worklist_head already taken off it.
+  std::vector<int> worklist;
+  std::size_t worklist_head = 0;
+  std::vector<bool> is_in_worklist(block_starts.size(), true);
+  for (std::size_t block = 0; block < block_starts.size(); ++block)
+    worklist.push_back(block);
+
+  // Number of states of each block that move into the current splitter. They
+  // are swapped to the front of their block as they are found.
+  std::vector<int> marked_counts(block_starts.size(), 0);
+  std::vector<int> touched_blocks;
+  while (worklist_head < worklist.size()) {
+    auto splitter = worklist[worklist_head++];
+    is_in_worklist[splitter] = false;
+    std::vector<int> splitter_states(
+        std::begin(states) + block_starts[splitter],
+        std::begin(states) + block_ends[splitter]);
+
+    for (auto byte_class = 0; byte_class < number_of_classes; ++byte_class) {
+      const auto* starts =
+          &predecessor_starts[byte_class * (number_of_completed_states + 1)];
+      const auto* symbol_predecessors =
+          &predecessors[byte_class * number_of_completed_states];
+      for (auto target : splitter_states) {
+        for (auto idx = starts[target]; idx < starts[target + 1]; ++idx) {
+          auto state = symbol_predecessors[idx];
+          auto block = block_of_state[state];
+          auto marked_location = block_starts[block] + marked_counts[block];
+          if (state_locations[state] < marked_location)
+            continue;  // Already marked.
+          auto displaced_state = states[marked_location];
+          std::swap(states[marked_location], states[state_locations[state]]);
+          state_locations[displaced_state] = state_locations[state];
+          state_locations[state] = marked_location;
+          if (marked_counts[block]++ == 0)
+            touched_blocks.push_back(block);
+        }
+      }
+
+      for (auto block : touched_blocks) {
+        auto marked_count = marked_counts[block];
+        marked_counts[block] = 0;
+        if (marked_count == block_ends[block] - block_starts[block])
+          continue;
+
+        // The marked states become a new block.
+        int new_block = block_starts.size();
+        block_starts.push_back(block_starts[block]);
+        block_ends.push_back(block_starts[block] + marked_count);
+        block_starts[block] += marked_count;
+        marked_counts.push_back(0);
+        for (auto idx = block_starts[new_block]; idx < block_ends[new_block];
+             ++idx)
+          block_of_state[states[idx]] = new_block;
+
+        if (is_in_worklist[block]) {
+          is_in_worklist.push_back(true);
+          worklist.push_back(new_block);
+        } else if (marked_count <= block_ends[block] - block_starts[block]) {
+          is_in_worklist.push_back(true);
+          worklist.push_back(new_block);
+        } else {
+          is_in_worklist.push_back(false);
+          is_in_worklist[block] = true;
+          worklist.push_back(block);
+        }
+      }
+      touched_blocks.clear();
+    }
+  }
+
+  // Number the blocks in the order their first state appears, which keeps
+  // the start state first. The block of the sink state becomes the dead
+  // state, unless the automaton accepts nothing at all, in which case the
+  // result is a single dead state.
+  AutomatonTables minimized_tables;
+  auto sink_block = block_of_state[sink_state];
+  if (block_of_state[tables.start_state] == sink_block) {
+    minimized_tables.transition_table = {kDeadState};
+    minimized_tables.final_state_tags = {-1};
+    return minimized_tables;
+  }
+
+  std::vector<int> minimized_state_of_block(block_starts.size(), kDeadState);
+  std::vector<int> representative_states;
+  auto number_of_minimized_states = 0;
+  for (auto state = 0; state < number_of_states; ++state) {
+    auto block = block_of_state[state];
+    if (block != sink_block &&
+        minimized_state_of_block[block] == kDeadState) {
+      minimized_state_of_block[block] = number_of_minimized_states++;
+      representative_states.push_back(state);
+    }
+  }
+
+  minimized_tables.start_state =
+      minimized_state_of_block[block_of_state[tables.start_state]];
+  minimized_tables.number_of_classes = number_of_classes;
+  minimized_tables.byte_classes = tables.byte_classes;
+  minimized_tables.transition_table.assign(
+      number_of_minimized_states * number_of_classes, kDeadState);
+  for (auto minimized_state = 0; minimized_state < number_of_minimized_states;
+       ++minimized_state) {
+    auto state = representative_states[minimized_state];
+    for (auto byte_class = 0; byte_class < number_of_classes; ++byte_class) {
+      minimized_tables.transition_table[
+          minimized_state * number_of_classes + byte_class] =
+          minimized_state_of_block[
+              block_of_state[next_state(state, byte_class)]];
+    }
+    minimized_tables.final_state_tags.push_back(
+        tables.final_state_tags[state]);
+  }
+  return minimized_tables;
+}
+
 /**
  * In our world, a non deterministic finite automaton consists of
  * 1. An initial state.
  * 2. A final state.
  * 3. A transition function that maps a state and a transition symbol to a
  *    state.
+ *
+ * An automaton built from a list of alternatives has one final state per
+ * alternative instead, tagged with the index of that alternative.
+ *
+ * An automaton is a fragment of a TransitionGraph it shares with the
+ * automata it was built from. Merging two automata of one graph only adds
+ * states and edges to it. Merging with an automaton of another graph first
+ * appends that graph to this one. Since copies share the graph too, an
+ * automaton must not be used again once it has been merged into another.
  */
 class NonDeterministicFiniteAutomaton {
  private:
+  std::shared_ptr<TransitionGraph> graph_;
   int start_state_{};
   int final_state_{};
-  TransitionGraph graph_;
-  std::unordered_map<int, std::unordered_set<int>> closure_sets_;
+  // Empty unless the automaton was built from a list of alternatives, in
+  // which case final_state_ alone is not the only final state.
+  std::unordered_map<int, int> final_state_tags_;
 
-  std::unordered_set<int> compute_closure(int state);
-  std::unordered_set<int> get_next_dfa_state(
-      const std::unordered_set<int>& current_dfa_state,
-      const std::string& transition_symbol);
-  void increment_state_numbers(int number);
+  int adopt_states_of(const NonDeterministicFiniteAutomaton& other_automaton);
 
  public:
-  NonDeterministicFiniteAutomaton() = default;
+  NonDeterministicFiniteAutomaton();
   explicit NonDeterministicFiniteAutomaton(const std::string& input_character);
+  explicit NonDeterministicFiniteAutomaton(const ByteSet& input_bytes);
+  NonDeterministicFiniteAutomaton(
+      std::shared_ptr<TransitionGraph> graph, const ByteSet& input_bytes);
+  NonDeterministicFiniteAutomaton(
+      std::shared_ptr<TransitionGraph> graph, int start_state, int final_state);
+  explicit NonDeterministicFiniteAutomaton(
+      std::vector<NonDeterministicFiniteAutomaton> alternatives);
   ~NonDeterministicFiniteAutomaton() = default;
 
   int get_start_state();
   int get_final_state();
+  std::shared_ptr<TransitionGraph> get_graph();
+  std::vector<int> get_final_state_tags();
   void merge_on_union(NonDeterministicFiniteAutomaton other_automaton);
   void merge_on_concatenation(NonDeterministicFiniteAutomaton other_automaton);
   void apply_star();
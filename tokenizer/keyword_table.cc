@@ -0,0 +1,83 @@
+#include "tokenizer/keyword_table.h"
+
+#include <algorithm>
+
+namespace tokenizer {
+
+/**
+ * Builds the perfect hash at run time. The table owns its pilots and slots
+ * through storage.
+ */
+KeywordTable::KeywordTable(
+    const std::vector<std::pair<std::string, int>>& keywords) {
+  auto keyword_hash = std::make_shared<const KeywordHash>(
+      build_keyword_hash(keywords));
+  *this = KeywordTable(
+      keyword_hash, keyword_hash->pilots, keyword_hash->slots);
+  is_valid_ = keyword_hash->is_valid;
+}
+
+KeywordTable::KeywordTable(
+    std::shared_ptr<const void> storage, std::span<const std::uint32_t> pilots,
+    std::span<const KeywordSlot> slots)
+    :storage_{std::move(storage)}, pilots_{pilots}, slots_{slots} {
+  if (pilots_.empty() || slots_.empty())
+    return;
+  slot_bits_ = std::countr_zero(slots_.size());
+  for (const auto& slot : slots_)
+    max_length_ = std::max<std::size_t>(max_length_, slot.length);
+}
+
+/**
+ * Returns the tag of a keyword, or -1 if the word is not one. Words longer
+ * than every keyword are rejected before hashing, so long identifiers cost a
+ * compare.
+ */
+int KeywordTable::find(std::string_view word) const {
+  if (word.size() > max_length_ || word.empty())
+    return -1;
+  auto words = get_keyword_words(word.data(), word.size());
+  auto key = get_keyword_key(words, word.size());
+  const auto& slot = slots_[get_keyword_slot(
+      key, pilots_[key & (pilots_.size() - 1)], slot_bits_)];
+  if (slot.length != word.size() ||
+      get_keyword_words(slot.bytes.data(), slot.length) != words)
+    return -1;
+  return slot.tag;
+}
+
+bool KeywordTable::is_empty() const {
+  return max_length_ == 0;
+}
+
+/**
+ * Returns false if the table was built from a list with an empty keyword, a
+ * keyword longer than KeywordSlot::kMaxLength bytes or a keyword listed
+ * twice. The table still finds the other keywords.
+ */
+bool KeywordTable::is_valid() const {
+  return is_valid_;
+}
+
+/**
+ * Returns the keywords and their tags in slot order.
+ */
+std::vector<std::pair<std::string, int>> KeywordTable::get_keywords() const {
+  std::vector<std::pair<std::string, int>> keywords;
+  for (const auto& slot : slots_) {
+    if (slot.length != 0)
+      keywords.emplace_back(
+          std::string(slot.bytes.data(), slot.length), slot.tag);
+  }
+  return keywords;
+}
+
+std::span<const std::uint32_t> KeywordTable::get_pilots() const {
+  return pilots_;
+}
+
+std::span<const KeywordSlot> KeywordTable::get_slots() const {
+  return slots_;
+}
+
+}  // namespace tokenizer
@@ -0,0 +1,316 @@
+#ifndef TOKENIZER_KEYWORD_TABLE_H_
+#define TOKENIZER_KEYWORD_TABLE_H_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tokenizer {
+
+/**
+ * A slot of a keyword table. Empty slots have length 0 and tag -1.
+ */
+struct KeywordSlot {
+  static constexpr std::size_t kMaxLength = 16;
+
+  std::array<char, kMaxLength> bytes{};
+  std::uint8_t length = 0;
+  int tag = -1;
+};
+
+/**
+ * Loads kSize bytes as a little-endian word. At run time on little-endian
+ * hosts this is one load.
+ */
+template <std::size_t kSize>
+constexpr std::uint64_t load_keyword_word(const char* bytes) {
+  if (!std::is_constant_evaluated() &&
+      std::endian::native == std::endian::little) {
+    if constexpr (kSize == 8) {
+      std::uint64_t word;
+      std::memcpy(&word, bytes, sizeof(word));
+      return word;
+    } else {
+      std::uint32_t word;
+      std::memcpy(&word, bytes, sizeof(word));
+      return word;
+    }
+  }
+  std::uint64_t word = 0;
+  for (std::size_t idx = 0; idx < kSize; ++idx)
+    word |= std::uint64_t{static_cast<unsigned char>(bytes[idx])} << 8 * idx;
+  return word;
+}
+
+/**
+ * Two words that together hold every byte of a word of 1 to
+ * KeywordSlot::kMaxLength bytes: its first and last 8 bytes, its first and
+ * last 4 bytes if it is shorter, or its first, middle and last byte if it
+ * is shorter still. Reading them takes fixed size loads only, and two words
+ * of the same length are equal exactly when these are.
+ */
+struct KeywordWords {
+  std::uint64_t head;
+  std::uint64_t tail;
+
+  constexpr bool operator==(const KeywordWords& other) const = default;
+};
+
+constexpr KeywordWords get_keyword_words(
+    const char* bytes, std::size_t length) {
+  if (length >= 8)
+    return {load_keyword_word<8>(bytes),
+            load_keyword_word<8>(bytes + length - 8)};
+  if (length >= 4)
+    return {load_keyword_word<4>(bytes),
+            load_keyword_word<4>(bytes + length - 4)};
+  std::uint64_t word = static_cast<unsigned char>(bytes[0]) |
+      static_cast<unsigned char>(bytes[length / 2]) << 8 |
+      static_cast<unsigned char>(bytes[length - 1]) << 16;
+  return {word, word};
+}
+
+/**
+ * Hashes a word from its KeywordWords and its length. The two products do
+ * not depend on each other, and folding the high half down mixes the low
+ * bits, which pick the bucket.
+ */
+constexpr std::uint64_t get_keyword_key(
+    const KeywordWords& words, std::size_t length) {
+  auto key = words.head * 0xFF51AFD7ED558CCDULL ^
+      (words.tail + length) * 0x9E3779B97F4A7C15ULL;
+  return key ^ key >> 32;
+}
+
+constexpr std::uint64_t get_keyword_key(std::string_view word) {
+  return get_keyword_key(
+      get_keyword_words(word.data(), word.size()), word.size());
+}
+
+/**
+ * Returns the slot of a key given the pilot of its bucket, out of
+ * 2^slot_bits slots.
+ */
+constexpr std::size_t get_keyword_slot(
+    std::uint64_t key, std::uint32_t pilot, int slot_bits) {
+  auto mixed_key = (key ^ pilot * 0x9E3779B97F4A7C15ULL) *
+      0xC4CEB9FE1A85EC53ULL;
+  return mixed_key >> (64 - slot_bits);
+}
+
+/**
+ * A perfect hash of a set of keywords, built by hash and displace. Each key
+ * falls into one of the buckets by its low bits, and each bucket has a pilot
+ * chosen so the keys of all buckets land in different slots. Buckets are
+ * placed largest first, while there are many free slots, and there are
+ * twice as many slots as keywords, so a pilot is found after a few tries.
+ * If some bucket has no pilot the slots are doubled.
+ *
+ * A lookup is one hash of the word, one pilot, one slot and one compare of
+ * the KeywordWords of the word with those of the slot, no matter how many
+ * keywords there are.
+ */
+struct KeywordHash {
+  static constexpr std::uint32_t kMaxPilot = 1 << 16;
+  static constexpr int kMaxSlotBits = 24;
+
+  std::vector<std::uint32_t> pilots;
+  std::vector<KeywordSlot> slots;
+  // False if a keyword is empty, longer than KeywordSlot::kMaxLength or a
+  // duplicate. Those keywords are left out.
+  bool is_valid = true;
+};
+
+/**
+ * Builds the perfect hash of a list of pairs whose first member is a
+ * keyword and whose second member converts to its int tag. When a keyword
+ * is listed twice, the first one wins. Works the same at compile time, see
+ * build_static_keyword_table, and at run time.
+ */
+template <typename Keywords>
+constexpr KeywordHash build_keyword_hash(const Keywords& keywords) {
+  KeywordHash keyword_hash;
+  std::vector<std::pair<std::string_view, int>> unique_keywords;
+  for (const auto& keyword_tag_pair : keywords) {
+    std::string_view keyword = keyword_tag_pair.first;
+    auto is_duplicate = false;
+    for (const auto& unique_keyword : unique_keywords)
+      is_duplicate = is_duplicate || unique_keyword.first == keyword;
+    if (keyword.empty() || keyword.size() > KeywordSlot::kMaxLength ||
+        is_duplicate) {
+      keyword_hash.is_valid = false;
+      continue;
+    }
+    unique_keywords.emplace_back(
+        keyword, static_cast<int>(keyword_tag_pair.second));
+  }
+  if (unique_keywords.empty())
+    return keyword_hash;
+
+  std::size_t number_of_keywords = unique_keywords.size();
+  auto number_of_buckets = std::bit_ceil((number_of_keywords + 1) / 2);
+  std::vector<std::uint64_t> keys;
+  std::vector<std::vector<int>> keywords_of_buckets(number_of_buckets);
+  for (std::size_t idx = 0; idx < number_of_keywords; ++idx) {
+    keys.push_back(get_keyword_key(unique_keywords[idx].first));
+    keywords_of_buckets[keys.back() & (number_of_buckets - 1)].push_back(idx);
+  }
+  // Buckets from largest to smallest, by insertion so it stays constexpr
+  // without a comparator.
+  std::vector<std::size_t> bucket_order;
+  for (std::size_t bucket = 0; bucket < number_of_buckets; ++bucket) {
+    auto idx = bucket_order.size();
+    bucket_order.push_back(bucket);
+    while (idx > 0 && keywords_of_buckets[bucket_order[idx - 1]].size() <
+                          keywords_of_buckets[bucket].size()) {
+      bucket_order[idx] = bucket_order[idx - 1];
+      --idx;
+    }
+    bucket_order[idx] = bucket;
+  }
+
+  auto slot_bits = std::bit_width(2 * number_of_keywords - 1);
+  for (; slot_bits <= KeywordHash::kMaxSlotBits; ++slot_bits) {
+    std::vector<int> keyword_of_slot(std::size_t{1} << slot_bits, -1);
+    std::vector<std::uint32_t> pilots(number_of_buckets, 0);
+    auto are_buckets_placed = true;
+    for (auto bucket : bucket_order) {
+      const auto& bucket_keywords = keywords_of_buckets[bucket];
+      auto is_placed = bucket_keywords.empty();
+      for (std::uint32_t pilot = 0;
+           pilot < KeywordHash::kMaxPilot && !is_placed; ++pilot) {
+        is_placed = true;
+        for (std::size_t idx = 0; idx < bucket_keywords.size() && is_placed;
+             ++idx) {
+          auto slot = get_keyword_slot(keys[bucket_keywords[idx]], pilot,
+                                       slot_bits);
+          is_placed = keyword_of_slot[slot] == -1;
+          for (std::size_t other_idx = 0; other_idx < idx; ++other_idx) {
+            is_placed = is_placed && slot != get_keyword_slot(
+                keys[bucket_keywords[other_idx]], pilot, slot_bits);
+          }
+        }
+        if (!is_placed)
+          continue;
+        pilots[bucket] = pilot;
+        for (auto keyword : bucket_keywords)
+          keyword_of_slot[get_keyword_slot(keys[keyword], pilot, slot_bits)] =
+              keyword;
+      }
+      if (!is_placed) {
+        are_buckets_placed = false;
+        break;
+      }
+    }
+    if (!are_buckets_placed)
+      continue;
+
+    keyword_hash.pilots = std::move(pilots);
+    keyword_hash.slots.resize(keyword_of_slot.size());
+    for (std::size_t slot = 0; slot < keyword_of_slot.size(); ++slot) {
+      if (keyword_of_slot[slot] == -1)
+        continue;
+      const auto& [keyword, tag] = unique_keywords[keyword_of_slot[slot]];
+      auto& keyword_slot = keyword_hash.slots[slot];
+      for (std::size_t idx = 0; idx < keyword.size(); ++idx)
+        keyword_slot.bytes[idx] = keyword[idx];
+      keyword_slot.length = keyword.size();
+      keyword_slot.tag = tag;
+    }
+    return keyword_hash;
+  }
+  keyword_hash.is_valid = false;
+  return keyword_hash;
+}
+
+/**
+ * Maps keywords to tags with a perfect hash, see KeywordHash. Like
+ * DeterministicFiniteAutomaton, the table only points at its pilots and
+ * slots, which are owned by storage, live in a constant built by
+ * build_static_keyword_table or are mapped from a file. Copies share them.
+ */
+class KeywordTable {
+ private:
+  std::shared_ptr<const void> storage_;
+  int slot_bits_ = 0;
+  // 0 for a table without keywords, so find rejects every word by length.
+  std::size_t max_length_ = 0;
+  std::span<const std::uint32_t> pilots_;
+  std::span<const KeywordSlot> slots_;
+  bool is_valid_ = true;
+
+ public:
+  KeywordTable() = default;
+  explicit KeywordTable(
+      const std::vector<std::pair<std::string, int>>& keywords);
+  KeywordTable(
+      std::shared_ptr<const void> storage,
+      std::span<const std::uint32_t> pilots,
+      std::span<const KeywordSlot> slots);
+  KeywordTable(const KeywordTable& other_table) = default;
+  KeywordTable(KeywordTable&& other_table) = default;
+  KeywordTable& operator=(const KeywordTable& other_table) = default;
+  KeywordTable& operator=(KeywordTable&& other_table) = default;
+  ~KeywordTable() = default;
+
+  int find(std::string_view word) const;
+  bool is_empty() const;
+  bool is_valid() const;
+  std::vector<std::pair<std::string, int>> get_keywords() const;
+  std::span<const std::uint32_t> get_pilots() const;
+  std::span<const KeywordSlot> get_slots() const;
+};
+
+/**
+ * The pilots and slots of a keyword table, computed by the compiler. See
+ * build_static_keyword_table.
+ */
+template <std::size_t kBuckets, std::size_t kSlots>
+struct StaticKeywordTable {
+  std::array<std::uint32_t, kBuckets> pilots{};
+  std::array<KeywordSlot, kSlots> slots{};
+  bool is_valid = true;
+
+  /**
+   * The table points into this object, so this is meant to be called on
+   * constants with static storage duration.
+   */
+  KeywordTable to_keyword_table() const {
+    return KeywordTable(nullptr, pilots, slots);
+  }
+};
+
+/**
+ * Builds the keyword table of a fixed list of keywords at compile time, the
+ * same way build_static_automaton builds an automaton: once to size the
+ * arrays and once to fill them.
+ */
+template <const auto& kKeywords>
+consteval auto build_static_keyword_table() {
+  constexpr auto kSizes = [] {
+    auto keyword_hash = build_keyword_hash(kKeywords);
+    return std::pair{keyword_hash.pilots.size(), keyword_hash.slots.size()};
+  }();
+  auto keyword_hash = build_keyword_hash(kKeywords);
+
+  StaticKeywordTable<kSizes.first, kSizes.second> static_table;
+  for (std::size_t idx = 0; idx < kSizes.first; ++idx)
+    static_table.pilots[idx] = keyword_hash.pilots[idx];
+  for (std::size_t idx = 0; idx < kSizes.second; ++idx)
+    static_table.slots[idx] = keyword_hash.slots[idx];
+  static_table.is_valid = keyword_hash.is_valid;
+  return static_table;
+}
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_KEYWORD_TABLE_H_
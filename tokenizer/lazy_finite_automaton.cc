@@ -0,0 +1,279 @@
+#include "tokenizer/lazy_finite_automaton.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+namespace tokenizer {
+
+/**
+ * Splits the bytes into the classes the NFA cannot tell apart, like
+ * convert_to_dfa does, and builds the start state.
+ */
+LazyDeterministicFiniteAutomaton::LazyDeterministicFiniteAutomaton(
+    NonDeterministicFiniteAutomaton nfa, std::size_t cache_capacity)
+    :graph_{nfa.get_graph()}, cache_capacity_{cache_capacity} {
+  auto number_of_nfa_states = graph_->get_number_of_states();
+  const auto& byte_set_transitions = graph_->get_byte_set_transitions();
+  std::vector<ByteSet> byte_sets;
+  for (const auto& transition : byte_set_transitions)
+    byte_sets.push_back(transition.input_bytes);
+  number_of_classes_ = compute_byte_classes(byte_sets, &byte_classes_);
+  class_transitions_.resize(number_of_nfa_states);
+  std::vector<bool> is_class_covered(number_of_classes_);
+  for (const auto& transition : byte_set_transitions) {
+    std::fill(std::begin(is_class_covered), std::end(is_class_covered), false);
+    for (auto symbol = 0;
+         symbol < DeterministicFiniteAutomaton::kNumberOfSymbols; ++symbol) {
+      auto byte_class = byte_classes_[symbol];
+      if (transition.input_bytes.contains(symbol) &&
+          !is_class_covered[byte_class]) {
+        is_class_covered[byte_class] = true;
+        class_transitions_[transition.start_state].emplace_back(
+            byte_class, transition.end_state);
+      }
+    }
+  }
+  epsilon_transitions_ = graph_->get_epsilon_adjacency_lists();
+  nfa_final_state_tags_ = nfa.get_final_state_tags();
+  visited_generations_.assign(number_of_nfa_states, 0);
+
+  ++generation_;
+  add_closure(nfa.get_start_state());
+  std::sort(std::begin(next_nfa_states_), std::end(next_nfa_states_));
+  start_nfa_states_ = next_nfa_states_;
+  start_state_ = insert_state(start_nfa_states_);
+  current_state_ = start_state_;
+}
+
+std::size_t LazyDeterministicFiniteAutomaton::NfaStateListHash::operator()(
+    const std::vector<int>& nfa_states) const {
+  // FNV-1a over the state numbers.
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (auto nfa_state : nfa_states) {
+    hash ^= static_cast<std::uint32_t>(nfa_state);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * The bytes a state takes up in the cache: its row of the transition table,
+ * its tag, its node in state_numbers_ with its list of NFA states, and the
+ * pointer to that list.
+ */
+std::size_t LazyDeterministicFiniteAutomaton::get_state_size(
+    const std::vector<int>& nfa_states) const {
+  constexpr std::size_t kHashNodeSize =
+      sizeof(std::vector<int>) + sizeof(int) + 3 * sizeof(void*);
+  return (number_of_classes_ + 1) * sizeof(int) + kHashNodeSize +
+      sizeof(void*) + nfa_states.size() * sizeof(int);
+}
+
+/**
+ * Drops every state and builds the start state and the state move() is in
+ * again. Other state numbers from before the flush are meaningless after it.
+ */
+void LazyDeterministicFiniteAutomaton::flush_cache() {
+  std::vector<int> current_nfa_states;
+  if (current_state_ >= 0)
+    current_nfa_states = *nfa_states_of_state_[current_state_];
+  ++number_of_cache_flushes_;
+  cache_size_ = 0;
+  nfa_states_of_state_.clear();
+  state_numbers_.clear();
+  transition_table_.clear();
+  final_state_tags_.clear();
+  start_state_ = insert_state(start_nfa_states_);
+  if (current_state_ >= 0) {
+    current_state_ = current_nfa_states == start_nfa_states_
+        ? start_state_ : insert_state(current_nfa_states);
+  }
+}
+
+/**
+ * Adds a state that is not in the cache, flushing the cache first if the
+ * state does not fit. A cache too small for even that still holds the start
+ * state, the state move() is in and the new state, so the automaton can
+ * always move.
+ */
+int LazyDeterministicFiniteAutomaton::add_state(
+    const std::vector<int>& nfa_states) {
+  if (!nfa_states_of_state_.empty() &&
+      cache_size_ + get_state_size(nfa_states) > cache_capacity_) {
+    flush_cache();
+    auto state_number = state_numbers_.find(nfa_states);
+    if (state_number != state_numbers_.end())
+      return state_number->second;
+  }
+  return insert_state(nfa_states);
+}
+
+int LazyDeterministicFiniteAutomaton::insert_state(
+    const std::vector<int>& nfa_states) {
+  int state = nfa_states_of_state_.size();
+  auto state_number = state_numbers_.emplace(nfa_states, state).first;
+  nfa_states_of_state_.push_back(&state_number->first);
+  transition_table_.resize(
+      transition_table_.size() + number_of_classes_, kUnknownState);
+
+  // The lowest tag of the final NFA states wins.
+  auto final_state_tag = -1;
+  for (auto nfa_state : nfa_states) {
+    auto nfa_final_state_tag = nfa_final_state_tags_[nfa_state];
+    if (nfa_final_state_tag != -1 &&
+        (final_state_tag == -1 || nfa_final_state_tag < final_state_tag))
+      final_state_tag = nfa_final_state_tag;
+  }
+  final_state_tags_.push_back(final_state_tag);
+  cache_size_ += get_state_size(nfa_states);
+  return state;
+}
+
+/**
+ * Adds the epsilon closure of an NFA state to next_nfa_states_, skipping the
+ * states already visited in this generation. Only states with transitions
+ * on bytes or a tag are kept, since the others never change where the
+ * automaton moves or what it accepts, and leaving them out makes states
+ * smaller and merges states that differ only in them.
+ */
+void LazyDeterministicFiniteAutomaton::add_closure(int nfa_state) {
+  if (visited_generations_[nfa_state] == generation_)
+    return;
+  visited_generations_[nfa_state] = generation_;
+  stack_.push_back(nfa_state);
+  while (!stack_.empty()) {
+    auto closure_state = stack_.back();
+    stack_.pop_back();
+    if (!class_transitions_[closure_state].empty() ||
+        nfa_final_state_tags_[closure_state] != -1)
+      next_nfa_states_.push_back(closure_state);
+    for (auto next_state : epsilon_transitions_[closure_state]) {
+      if (visited_generations_[next_state] != generation_) {
+        visited_generations_[next_state] = generation_;
+        stack_.push_back(next_state);
+      }
+    }
+  }
+}
+
+/**
+ * Builds the state reached from a cached state on a byte class, or finds it
+ * in the cache, and fills in the transition. If building it flushed the
+ * cache, the old state is gone and only the new one is returned.
+ */
+int LazyDeterministicFiniteAutomaton::compute_next_state(
+    int state, int byte_class) {
+  if (generation_ == std::numeric_limits<int>::max()) {
+    std::fill(
+        std::begin(visited_generations_), std::end(visited_generations_), 0);
+    generation_ = 0;
+  }
+  ++generation_;
+  next_nfa_states_.clear();
+  for (auto nfa_state : *nfa_states_of_state_[state]) {
+    for (const auto& class_state_pair : class_transitions_[nfa_state]) {
+      if (class_state_pair.first == byte_class)
+        add_closure(class_state_pair.second);
+    }
+  }
+
+  auto next_state = DeterministicFiniteAutomaton::kDeadState;
+  if (!next_nfa_states_.empty()) {
+    std::sort(std::begin(next_nfa_states_), std::end(next_nfa_states_));
+    auto state_number = state_numbers_.find(next_nfa_states_);
+    if (state_number != state_numbers_.end()) {
+      next_state = state_number->second;
+    } else {
+      auto number_of_cache_flushes = number_of_cache_flushes_;
+      next_state = add_state(next_nfa_states_);
+      if (number_of_cache_flushes != number_of_cache_flushes_)
+        return next_state;
+    }
+  }
+  transition_table_[state * number_of_classes_ + byte_class] = next_state;
+  return next_state;
+}
+
+void LazyDeterministicFiniteAutomaton::move(char input_symbol) {
+  if (!is_dead_) {
+    auto input_byte = static_cast<unsigned char>(input_symbol);
+    auto byte_class = byte_classes_[input_byte];
+    auto next_state =
+        transition_table_[current_state_ * number_of_classes_ + byte_class];
+    if (next_state == kUnknownState)
+      next_state = compute_next_state(current_state_, byte_class);
+    current_state_ = next_state;
+
+    if (current_state_ == DeterministicFiniteAutomaton::kDeadState) {
+      is_dead_ = true;
+      has_accepted_ = false;
+    } else {
+      has_accepted_ = final_state_tags_[current_state_] != -1;
+    }
+  }
+}
+
+void LazyDeterministicFiniteAutomaton::reset() {
+  current_state_ = start_state_;
+  is_dead_ = false;
+  has_accepted_ = false;
+}
+
+bool LazyDeterministicFiniteAutomaton::has_accepted() {
+  return has_accepted_;
+}
+
+bool LazyDeterministicFiniteAutomaton::is_dead() {
+  return is_dead_;
+}
+
+int LazyDeterministicFiniteAutomaton::get_final_state_tag() {
+  if (!has_accepted_)
+    return -1;
+  return final_state_tags_[current_state_];
+}
+
+int LazyDeterministicFiniteAutomaton::get_number_of_classes() {
+  return number_of_classes_;
+}
+
+int LazyDeterministicFiniteAutomaton::get_number_of_cached_states() {
+  return nfa_states_of_state_.size();
+}
+
+int LazyDeterministicFiniteAutomaton::get_number_of_cache_flushes() {
+  return number_of_cache_flushes_;
+}
+
+std::size_t LazyDeterministicFiniteAutomaton::get_cache_size() {
+  return cache_size_;
+}
+
+/**
+ * Same as DeterministicFiniteAutomaton::find_longest_match, building states
+ * as the input reaches them. It does not touch current_state_.
+ */
+std::size_t LazyDeterministicFiniteAutomaton::find_longest_match(
+    std::string_view input, std::size_t offset, int* final_state_tag) {
+  std::size_t match_length = 0;
+  *final_state_tag = -1;
+  auto state = start_state_;
+  for (auto idx = offset; idx < input.size(); ++idx) {
+    auto byte_class = byte_classes_[static_cast<unsigned char>(input[idx])];
+    auto next_state = transition_table_[state * number_of_classes_ + byte_class];
+    if (next_state == kUnknownState)
+      next_state = compute_next_state(state, byte_class);
+    if (next_state == DeterministicFiniteAutomaton::kDeadState)
+      break;
+    state = next_state;
+    if (final_state_tags_[state] != -1) {
+      match_length = idx - offset + 1;
+      *final_state_tag = final_state_tags_[state];
+    }
+  }
+  return match_length;
+}
+
+}  // namespace tokenizer
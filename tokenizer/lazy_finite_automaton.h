@@ -0,0 +1,101 @@
+#ifndef TOKENIZER_LAZY_FINITE_AUTOMATON_H_
+#define TOKENIZER_LAZY_FINITE_AUTOMATON_H_
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tokenizer/finite_automaton.h"
+
+namespace tokenizer {
+
+/**
+ * A deterministic automaton whose states are built from an NFA the first
+ * time the input reaches them, instead of all up front by convert_to_dfa.
+ * Patterns like (a|b)*a(a|b)(a|b)(a|b) have DFAs exponentially larger than
+ * their NFAs, but an input only ever visits a few of those states.
+ *
+ * A DFA state is the sorted list of the NFA states it stands for. Built
+ * states and their transitions are kept in a cache of at most
+ * cache_capacity bytes, so memory stays bounded no matter the pattern. When
+ * a new state does not fit, the whole cache is flushed and states are built
+ * again as they are reached. Transitions not followed yet are kUnknownState
+ * in the transition table, so the inputs that stay in cached states run
+ * at the speed of a DeterministicFiniteAutomaton.
+ *
+ * Final states carry the lowest tag of the NFA states they contain, like in
+ * convert_to_dfa. Moving changes the cache, so even find_longest_match is
+ * not const and an automaton must not be shared between threads.
+ */
+class LazyDeterministicFiniteAutomaton {
+ public:
+  static constexpr std::size_t kDefaultCacheCapacity = 1 << 20;
+  static constexpr int kUnknownState = -2;
+
+ private:
+  struct NfaStateListHash {
+    std::size_t operator()(const std::vector<int>& nfa_states) const;
+  };
+
+  // The NFA, with its transitions on byte classes grouped by start state.
+  std::shared_ptr<TransitionGraph> graph_;
+  ByteClasses byte_classes_{};
+  int number_of_classes_ = 1;
+  std::vector<std::vector<std::pair<int, int>>> class_transitions_;
+  std::vector<std::vector<int>> epsilon_transitions_;
+  std::vector<int> nfa_final_state_tags_;
+  std::vector<int> start_nfa_states_;
+
+  // The cache.
+  std::size_t cache_capacity_;
+  std::size_t cache_size_ = 0;
+  int number_of_cache_flushes_ = 0;
+  // The NFA states of each state point to the keys of state_numbers_.
+  std::unordered_map<std::vector<int>, int, NfaStateListHash> state_numbers_;
+  std::vector<const std::vector<int>*> nfa_states_of_state_;
+  std::vector<int> transition_table_;
+  std::vector<int> final_state_tags_;
+  int start_state_ = 0;
+
+  // Scratch space for computing the next state.
+  std::vector<int> visited_generations_;
+  int generation_ = 0;
+  std::vector<int> next_nfa_states_;
+  std::vector<int> stack_;
+
+  int current_state_ = 0;
+  bool has_accepted_ = false;
+  bool is_dead_ = false;
+
+  std::size_t get_state_size(const std::vector<int>& nfa_states) const;
+  void flush_cache();
+  int add_state(const std::vector<int>& nfa_states);
+  int insert_state(const std::vector<int>& nfa_states);
+  void add_closure(int nfa_state);
+  int compute_next_state(int state, int byte_class);
+
+ public:
+  explicit LazyDeterministicFiniteAutomaton(
+      NonDeterministicFiniteAutomaton nfa,
+      std::size_t cache_capacity = kDefaultCacheCapacity);
+  ~LazyDeterministicFiniteAutomaton() = default;
+
+  void move(char input_symbol);
+  void reset();
+  bool has_accepted();
+  bool is_dead();
+  int get_final_state_tag();
+  int get_number_of_classes();
+  int get_number_of_cached_states();
+  int get_number_of_cache_flushes();
+  std::size_t get_cache_size();
+  std::size_t find_longest_match(
+      std::string_view input, std::size_t offset, int* final_state_tag);
+};
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_LAZY_FINITE_AUTOMATON_H_
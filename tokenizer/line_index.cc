@@ -0,0 +1,123 @@
+#include "tokenizer/line_index.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+
+namespace tokenizer {
+
+/**
+ * Appends the offset every line of the source starts at, that is 0 and the
+ * offset after each '\n', to line_starts.
+ */
+void find_line_starts_scalar(
+    std::string_view source, std::vector<std::uint32_t>* line_starts) {
+  line_starts->push_back(0);
+  for (std::size_t idx = 0; idx < source.size(); ++idx) {
+    if (source[idx] == '\n')
+      line_starts->push_back(idx + 1);
+  }
+}
+
+/**
+ * Same as find_line_starts_scalar, but compares 32 bytes at a time with AVX2
+ * or 16 at a time with SSE2 when the compiler targets them. A first pass
+ * counts the newlines of each vector from its compare mask, so line_starts
+ * grows once. The second pass walks the set bits of each mask.
+ */
+void find_line_starts(
+    std::string_view source, std::vector<std::uint32_t>* line_starts) {
+#if defined(__AVX2__)
+  constexpr std::size_t kVectorSize = 32;
+  auto newlines = _mm256_set1_epi8('\n');
+  auto get_newline_mask = [&](std::size_t idx) {
+    auto bytes = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(source.data() + idx));
+    return static_cast<std::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newlines)));
+  };
+#elif defined(__SSE2__)
+  constexpr std::size_t kVectorSize = 16;
+  auto newlines = _mm_set1_epi8('\n');
+  auto get_newline_mask = [&](std::size_t idx) {
+    auto bytes = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(source.data() + idx));
+    return static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newlines)));
+  };
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  auto vector_end_idx = source.size() - source.size() % kVectorSize;
+  std::size_t number_of_newlines = 0;
+  for (std::size_t idx = 0; idx < vector_end_idx; idx += kVectorSize)
+    number_of_newlines += __builtin_popcount(get_newline_mask(idx));
+  number_of_newlines += std::count(
+      std::begin(source) + vector_end_idx, std::end(source), '\n');
+  line_starts->reserve(line_starts->size() + number_of_newlines + 1);
+
+  line_starts->push_back(0);
+  for (std::size_t idx = 0; idx < vector_end_idx; idx += kVectorSize) {
+    for (auto mask = get_newline_mask(idx); mask != 0; mask &= mask - 1)
+      line_starts->push_back(idx + __builtin_ctz(mask) + 1);
+  }
+  for (auto idx = vector_end_idx; idx < source.size(); ++idx) {
+    if (source[idx] == '\n')
+      line_starts->push_back(idx + 1);
+  }
+#else
+  find_line_starts_scalar(source, line_starts);
+#endif
+}
+
+void LineIndex::build() {
+  find_line_starts(source_, &line_starts_);
+}
+
+/**
+ * Returns the line and column of a byte offset. The offset of the end of the
+ * source is on the last line, right after its last byte. Offsets past the end
+ * are clamped to it.
+ */
+SourceLocation LineIndex::get_location(std::size_t offset) {
+  if (!is_built())
+    build();
+  offset = std::min(offset, source_.size());
+  // The last line that starts at or before the offset.
+  auto line = std::upper_bound(
+      std::begin(line_starts_), std::end(line_starts_), offset) -
+      std::begin(line_starts_);
+  return {static_cast<std::size_t>(line), offset - line_starts_[line - 1] + 1};
+}
+
+/**
+ * Returns the text of a line, counted from 1, without its '\n'. Lines
+ * outside 1 to get_number_of_lines() are empty.
+ */
+std::string_view LineIndex::get_line(std::size_t line) {
+  if (!is_built())
+    build();
+  if (line == 0 || line > line_starts_.size())
+    return std::string_view();
+  auto line_start_idx = line_starts_[line - 1];
+  auto line_end_idx = line < line_starts_.size()
+      ? line_starts_[line] - 1 : source_.size();
+  return source_.substr(line_start_idx, line_end_idx - line_start_idx);
+}
+
+std::size_t LineIndex::get_number_of_lines() {
+  if (!is_built())
+    build();
+  return line_starts_.size();
+}
+
+bool LineIndex::is_built() const {
+  return !line_starts_.empty();
+}
+
+}  // namespace tokenizer
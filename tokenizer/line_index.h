@@ -0,0 +1,62 @@
+#ifndef TOKENIZER_LINE_INDEX_H_
+#define TOKENIZER_LINE_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace tokenizer {
+
+/**
+ * A position in a source. Lines and columns are counted from 1, and columns
+ * count bytes.
+ */
+struct SourceLocation {
+  std::size_t line;
+  std::size_t column;
+};
+
+void find_line_starts(
+    std::string_view source, std::vector<std::uint32_t>* line_starts);
+void find_line_starts_scalar(
+    std::string_view source, std::vector<std::uint32_t>* line_starts);
+
+/**
+ * Maps byte offsets in a source, like those of a TokenBuffer, to lines and
+ * columns. Tokens only store offsets, so lexing never pays for locations.
+ * The index of line starts is built the first time a location is asked for,
+ * and every lookup after that is a binary search over it.
+ *
+ * Lines end at '\n'. Like a TokenBuffer, the index does not own its source,
+ * and offsets are 32 bit, so the source must be smaller than 4 GiB. Valid
+ * offsets go from 0 to the size of the source and valid lines from 1 to
+ * get_number_of_lines(). Offsets past the end are clamped to it, and lines
+ * out of range are empty, so no lookup reads outside the source. Building
+ * the index changes it, so an index must not be shared between threads
+ * before it is built.
+ */
+class LineIndex {
+ private:
+  std::string_view source_;
+  // The offset each line starts at. Empty until the index is built.
+  std::vector<std::uint32_t> line_starts_;
+
+  void build();
+
+ public:
+  LineIndex() = default;
+  explicit LineIndex(std::string_view source)
+    :source_{source}
+  {}
+  ~LineIndex() = default;
+
+  SourceLocation get_location(std::size_t offset);
+  std::string_view get_line(std::size_t line);
+  std::size_t get_number_of_lines();
+  bool is_built() const;
+};
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_LINE_INDEX_H_
@@ -1,146 +1,330 @@
 #include "tokenizer/regular_expression.h"
 
-#include <deque>
+#include <algorithm>
+#include <cstring>
+#include <utility>
 
 namespace tokenizer {
 
-RegularExpression::RegularExpression(std::string expression_string)
-    :expression_string_{std::move(expression_string)} {
-  first_operand_ = get_first_operand();
-  operator_ = get_operator();
-  second_operand_ = get_second_operand();
-  auto nfa = convert_to_nfa();
-  auto dfa = nfa.convert_to_dfa();
-  automaton_ = dfa;
-}
-
-std::string RegularExpression::get_first_operand() {
-  if (expression_string_.size() == 1) {
-    return expression_string_;
-  } else if (expression_string_[0] != '(') {
-    auto first_operand_length = expression_string_.size() / 2;
-    first_operand_ = expression_string_.substr(0, first_operand_length);
-    if (first_operand_[first_operand_.size() - 1] == '|') {
-      first_operand_ = first_operand_.substr(0, first_operand_.size() - 1);
+/**
+ * Adds the automaton of a syntax tree to a graph, so the automata of several
+ * expressions can be built in one graph and merged without copying states.
+ */
+NonDeterministicFiniteAutomaton build_nfa(
+    const RegularExpressionTree& tree, std::shared_ptr<TransitionGraph> graph) {
+  auto fragment = build_thompson_fragment(tree, graph.get());
+  return NonDeterministicFiniteAutomaton(
+      std::move(graph), fragment.start_state, fragment.final_state);
+}
+
+namespace {
+
+/**
+ * What find_required_literal knows about the matches of a node: the length
+ * they all have, or -1 if they differ, and a literal they all contain at
+ * one offset. If the literal starts at 0 and is as long as every match, the
+ * node matches exactly the literal.
+ */
+struct LiteralFragment {
+  int fixed_length = 0;
+  RequiredLiteral required_literal;
+};
+
+/**
+ * Keeps the longer literal, or the first one if they are equally long.
+ */
+void keep_longer_literal(
+    RequiredLiteral other_literal, RequiredLiteral* required_literal) {
+  if (other_literal.literal.size() > required_literal->literal.size())
+    *required_literal = std::move(other_literal);
+}
+
+}  // namespace
+
+/**
+ * Like build_thompson_fragment, looks at the nodes in one pass. A
+ * concatenation keeps the longer literal of its operands, and joins them if
+ * the first operand ends in its literal and the second starts with its own.
+ * The literal of the second operand is only at a known offset if the first
+ * operand has a fixed length. An alternation keeps the common prefix of the
+ * literals of its operands if they are at one offset. Each node is the
+ * operand of at most one other node, so literals are moved up the tree
+ * instead of copied.
+ */
+RequiredLiteral find_required_literal(const RegularExpressionTree& tree) {
+  if (tree.empty())
+    return {};
+  std::vector<LiteralFragment> fragments(tree.size());
+  for (std::size_t idx = 0; idx < tree.size(); ++idx) {
+    const auto& node = tree[idx];
+    auto& fragment = fragments[idx];
+    if (node.node_type == RegularExpressionNodeType::byte_set) {
+      fragment.fixed_length = 1;
+      for (auto symbol = 0; symbol < 256; ++symbol) {
+        if (node.input_bytes == ByteSet(symbol))
+          fragment.required_literal.literal = std::string(1, symbol);
+      }
+    } else if (node.node_type == RegularExpressionNodeType::empty) {
+      fragment.fixed_length = 0;
+    } else if (node.node_type == RegularExpressionNodeType::concat) {
+      auto first_fragment = std::move(fragments[node.first_operand]);
+      auto second_fragment = std::move(fragments[node.second_operand]);
+      auto& first_literal = first_fragment.required_literal;
+      auto& second_literal = second_fragment.required_literal;
+      fragment.fixed_length = -1;
+      if (first_fragment.fixed_length != -1 &&
+          second_fragment.fixed_length != -1) {
+        fragment.fixed_length =
+            first_fragment.fixed_length + second_fragment.fixed_length;
+      }
+      if (first_fragment.fixed_length == -1) {
+        fragment.required_literal = std::move(first_literal);
+      } else if (first_literal.offset + first_literal.literal.size() ==
+                     static_cast<std::size_t>(first_fragment.fixed_length) &&
+                 second_literal.offset == 0) {
+        first_literal.literal += second_literal.literal;
+        fragment.required_literal = std::move(first_literal);
+      } else {
+        second_literal.offset += first_fragment.fixed_length;
+        fragment.required_literal = std::move(first_literal);
+        keep_longer_literal(
+            std::move(second_literal), &fragment.required_literal);
+      }
+    } else if (node.node_type == RegularExpressionNodeType::unio) {
+      auto& first_fragment = fragments[node.first_operand];
+      const auto& second_fragment = fragments[node.second_operand];
+      auto& first_literal = first_fragment.required_literal;
+      const auto& second_literal = second_fragment.required_literal;
+      fragment.fixed_length =
+          first_fragment.fixed_length == second_fragment.fixed_length
+          ? first_fragment.fixed_length : -1;
+      if (first_literal.offset == second_literal.offset) {
+        auto prefix_end = std::mismatch(
+            std::begin(first_literal.literal), std::end(first_literal.literal),
+            std::begin(second_literal.literal),
+            std::end(second_literal.literal)).first;
+        first_literal.literal.erase(prefix_end, std::end(first_literal.literal));
+        fragment.required_literal = std::move(first_literal);
+      }
+    } else {
+      // Only a star of empty matches has a fixed length.
+      fragment.fixed_length =
+          fragments[node.first_operand].fixed_length == 0 ? 0 : -1;
     }
-  } else {
-    auto matching_parenthesis_idx =
-        get_matching_parenthesis_index(expression_string_);
-    first_operand_ = expression_string_.substr(0, matching_parenthesis_idx);
+    if (fragment.required_literal.literal.empty())
+      fragment.required_literal.offset = 0;
   }
-
-  return first_operand_;
+  return std::move(fragments.back().required_literal);
 }
 
-RegularExpressionOperatorType RegularExpression::get_operator() {
-  auto first_operand_length = first_operand_.size();
+RegularExpression::RegularExpression(std::string expression_string)
+    :RegularExpression(std::move(expression_string), AutomatonMode::eager)
+{}
 
-  if (expression_string_[first_operand_length] == '*') {
-    operator_ = RegularExpressionOperatorType::star;
-  } else if (expression_string_[first_operand_length] == '|') {
-    operator_ = RegularExpressionOperatorType::unio;
+/**
+ * In lazy mode, only the states reached from the start state on one byte
+ * are built up front, to find the bytes a match can start with. The lazy
+ * automaton keeps its cache between calls, so a lazy expression must not be
+ * used from several threads at once. Its copies can, see the copy
+ * constructor.
+ */
+RegularExpression::RegularExpression(
+    std::string expression_string, AutomatonMode mode,
+    std::size_t cache_capacity)
+    :expression_string_{std::move(expression_string)},
+    tree_{parse_regular_expression(expression_string_)},
+    cache_capacity_{cache_capacity} {
+  if (mode == AutomatonMode::lazy) {
+    lazy_automaton_ = build_lazy_automaton();
+    for (auto symbol = 0; symbol < 256; ++symbol) {
+      lazy_automaton_->reset();
+      lazy_automaton_->move(static_cast<char>(symbol));
+      if (!lazy_automaton_->is_dead())
+        start_bytes_.insert(symbol);
+    }
+    lazy_automaton_->reset();
   } else {
-    operator_ = RegularExpressionOperatorType::concat;
+    auto nfa = convert_to_nfa();
+    auto dfa = nfa.convert_to_dfa();
+    number_of_unminimized_states_ = dfa.get_number_of_states();
+    automaton_ = dfa.minimize();
+
+    auto start_state = automaton_.get_start_state();
+    auto transition_table = automaton_.get_transition_table();
+    auto number_of_classes = automaton_.get_number_of_classes();
+    for (auto symbol = 0; symbol < 256; ++symbol) {
+      if (transition_table[start_state * number_of_classes +
+                           automaton_.get_byte_class(symbol)] !=
+          DeterministicFiniteAutomaton::kDeadState)
+        start_bytes_.insert(symbol);
+    }
   }
 
-  return operator_;
+  required_literal_ = find_required_literal(tree_);
+  auto is_in_range = false;
+  for (auto symbol = 0; symbol < 256; ++symbol) {
+    auto is_skipped = !start_bytes_.contains(symbol);
+    if (is_skipped && !is_in_range) {
+      if (skipped_bytes_.number_of_ranges == SelfLoop::kMaxNumberOfRanges) {
+        skipped_bytes_ = SelfLoop();
+        break;
+      }
+      skipped_bytes_.range_starts[skipped_bytes_.number_of_ranges++] = symbol;
+    }
+    if (is_skipped)
+      skipped_bytes_.range_ends[skipped_bytes_.number_of_ranges - 1] = symbol;
+    is_in_range = is_skipped;
+  }
 }
 
-std::string RegularExpression::get_second_operand() {
-  int operator_length;
-  if (operator_ == RegularExpressionOperatorType::unio ||
-      operator_ == RegularExpressionOperatorType::star) {
-    operator_length = 1;
-  } else {
-    operator_length = 0;
-  }
+/**
+ * A lazy automaton cannot be copied, since its states point into its own
+ * hash map, so a copy of a lazy expression starts an empty cache of the
+ * same capacity from the syntax tree. Copies never share a cache, and each
+ * can be used on its own thread.
+ */
+RegularExpression::RegularExpression(const RegularExpression& other_expression)
+    :expression_string_{other_expression.expression_string_},
+    tree_{other_expression.tree_},
+    automaton_{other_expression.automaton_},
+    cache_capacity_{other_expression.cache_capacity_},
+    number_of_unminimized_states_{
+        other_expression.number_of_unminimized_states_},
+    required_literal_{other_expression.required_literal_},
+    start_bytes_{other_expression.start_bytes_},
+    skipped_bytes_{other_expression.skipped_bytes_} {
+  if (other_expression.lazy_automaton_ != nullptr)
+    lazy_automaton_ = build_lazy_automaton();
+}
 
-  auto second_operand_start_index = first_operand_.size() + operator_length;
-  auto second_operand_length = expression_string_.size() -
-      second_operand_start_index;
-  second_operand_ = expression_string_.substr(
-      second_operand_start_index, second_operand_length);
+RegularExpression& RegularExpression::operator=(
+    const RegularExpression& other_expression) {
+  if (this != &other_expression)
+    *this = RegularExpression(other_expression);
+  return *this;
+}
 
-  return second_operand_;
+std::unique_ptr<LazyDeterministicFiniteAutomaton>
+RegularExpression::build_lazy_automaton() const {
+  return std::make_unique<LazyDeterministicFiniteAutomaton>(
+      build_nfa(tree_, std::make_shared<TransitionGraph>()), cache_capacity_);
 }
 
 NonDeterministicFiniteAutomaton RegularExpression::convert_to_nfa() {
-  if (expression_string_.length() == 1) {
-    NonDeterministicFiniteAutomaton nfa(expression_string_);
-    return nfa;
-  }
+  return convert_to_nfa(std::make_shared<TransitionGraph>());
+}
 
-  auto first_operand_string = get_first_operand();
-  first_operand_string = trim_parenthesis(first_operand_string);
-  RegularExpression first_operand_regex(first_operand_string);
-  auto first_operand_nfa = first_operand_regex.convert_to_nfa();
-
-  auto regex_operator = get_operator();
-  if (regex_operator != RegularExpressionOperatorType::star) {
-    auto second_operand_string = get_second_operand();
-    second_operand_string = trim_parenthesis(second_operand_string);
-    RegularExpression second_operand_regex(second_operand_string);
-    auto second_operand_nfa = second_operand_regex.convert_to_nfa();
-
-    if (operator_ == RegularExpressionOperatorType::unio) {
-      first_operand_nfa.merge_on_union(second_operand_nfa);
-    } else if (operator_ == RegularExpressionOperatorType::concat) {
-      first_operand_nfa.merge_on_concatenation(second_operand_nfa);
-    }
-  } else {
-    first_operand_nfa.apply_star();
-  }
-  return first_operand_nfa;
+NonDeterministicFiniteAutomaton RegularExpression::convert_to_nfa(
+    std::shared_ptr<TransitionGraph> graph) {
+  return build_nfa(tree_, std::move(graph));
 }
 
-std::string RegularExpression::match(const std::string& input) {
-  automaton_.reset();
-  auto match_idx = -1;
-  for (auto idx = 0; idx < input.size(); ++idx) {
-    auto input_character_string = std::string(1, input[idx]);
-    automaton_.move(input_character_string);
-    if (automaton_.has_accepted()) {
-      match_idx = idx;
-    }
-    if (automaton_.is_dead()) {
-      break;
-    }
-  }
+const RegularExpressionTree& RegularExpression::get_tree() const {
+  return tree_;
+}
 
-  if (match_idx == -1) {
-    return "";
-  } else if (match_idx == 0) {
-    return std::string(1, input[0]);
-  } else {
-    return input.substr(0, match_idx + 1);
-  }
+std::string RegularExpression::match(const std::string& input) const {
+  return input.substr(0, match_length(input, 0));
 }
 
-int get_matching_parenthesis_index(std::string input) {
-  // If the first character is a parenthesis, match it using stack.
-  std::deque<char> stack {input[0]};
-  for (auto idx = 1; idx < input.size(); ++idx) {
-    if (stack.empty()) {
-      return idx;
-    } else if (input[idx] == ')') {
-      stack.pop_front();
-    } else if (input[idx] == '(') {
-      stack.push_front(input[idx]);
+/**
+ * Returns the length of the longest match starting at offset, or 0 if there
+ * is none. The eager automaton runs in a local variable, so this allocates
+ * nothing and can be called from several threads at once. The lazy one may
+ * build states, or flush its cache, and cannot.
+ */
+std::size_t RegularExpression::match_length(
+    std::string_view input, std::size_t offset) const {
+  int final_state_tag;
+  if (lazy_automaton_ != nullptr)
+    return lazy_automaton_->find_longest_match(
+        input, offset, &final_state_tag);
+  return automaton_.find_longest_match(input, offset, &final_state_tag);
+}
+
+/**
+ * Stores the length of the longest match at the start of each input in
+ * match_lengths, which must be at least as long as inputs.
+ */
+void RegularExpression::match_lengths(
+    std::span<const std::string_view> inputs,
+    std::span<std::size_t> match_lengths) const {
+  for (std::size_t idx = 0; idx < inputs.size(); ++idx)
+    match_lengths[idx] = match_length(inputs[idx], 0);
+}
+
+/**
+ * Returns the first offset from idx on where a match can start, or the size
+ * of the haystack if there is none.
+ */
+std::size_t RegularExpression::find_candidate(
+    std::string_view haystack, std::size_t idx) const {
+  const auto& [literal, literal_offset] = required_literal_;
+  if (!literal.empty()) {
+    if (idx + literal_offset >= haystack.size())
+      return haystack.size();
+    std::size_t literal_idx;
+    if (literal.size() == 1) {
+      const auto* literal_byte = static_cast<const char*>(std::memchr(
+          haystack.data() + idx + literal_offset, literal[0],
+          haystack.size() - idx - literal_offset));
+      literal_idx = literal_byte == nullptr
+          ? std::string_view::npos : literal_byte - haystack.data();
+    } else {
+      literal_idx = haystack.find(literal, idx + literal_offset);
     }
+    if (literal_idx == std::string_view::npos)
+      return haystack.size();
+    return literal_idx - literal_offset;
   }
+  if (skipped_bytes_.number_of_ranges != 0)
+    return find_self_loop_end(skipped_bytes_, haystack, idx);
+  while (idx < haystack.size() &&
+         !start_bytes_.contains(static_cast<unsigned char>(haystack[idx])))
+    ++idx;
+  return idx;
+}
 
-  if (stack.empty()) {
-    return input.size() - 1;
-  } else {
-    return -1;
+/**
+ * Returns the leftmost longest matches that do not overlap, in order.
+ * Empty matches are left out, like match_length does. The automaton only
+ * runs from candidate offsets, see find_candidate, so on text where the
+ * expression rarely matches most bytes are only looked at by memchr or a
+ * SIMD compare.
+ */
+std::vector<RegularExpressionMatch> RegularExpression::find_all(
+    std::string_view haystack) const {
+  std::vector<RegularExpressionMatch> matches;
+  auto idx = find_candidate(haystack, 0);
+  while (idx < haystack.size()) {
+    auto length = match_length(haystack, idx);
+    if (length == 0) {
+      idx = find_candidate(haystack, idx + 1);
+      continue;
+    }
+    matches.push_back({idx, length});
+    idx = find_candidate(haystack, idx + length);
   }
+  return matches;
+}
+
+const RequiredLiteral& RegularExpression::get_required_literal() const {
+  return required_literal_;
+}
+
+/**
+ * In lazy mode, both state counts are the number of states in the cache.
+ */
+int RegularExpression::get_number_of_unminimized_states() {
+  if (lazy_automaton_ != nullptr)
+    return lazy_automaton_->get_number_of_cached_states();
+  return number_of_unminimized_states_;
 }
 
-std::string trim_parenthesis(const std::string& input) {
-  if (input[0] == '(' && input[input.size() - 1] == ')')
-    return input.substr(1, input.size() - 2);
-  else
-    return input;
+int RegularExpression::get_number_of_states() {
+  if (lazy_automaton_ != nullptr)
+    return lazy_automaton_->get_number_of_cached_states();
+  return automaton_.get_number_of_states();
 }
 
 }  // namespace tokenizer
@@ -1,38 +1,592 @@
 #ifndef TOKENIZER_REGULAR_EXPRESSION_H_
 #define TOKENIZER_REGULAR_EXPRESSION_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "tokenizer/finite_automaton.h"
+#include "tokenizer/lazy_finite_automaton.h"
+#include "tokenizer/utf8.h"
 
 namespace tokenizer {
 
-enum class RegularExpressionOperatorType { unio, concat, star };
+/**
+ * Returns the length of the atom starting at idx. An atom is an escape like
+ * \\d or \\u{e9}, a character class like [a-z] or a single character, which
+ * takes all the bytes of its UTF-8 sequence. An unterminated class or \\u{
+ * escape extends to the end of the input.
+ */
+constexpr std::size_t get_atom_length(
+    std::string_view input, std::size_t idx) {
+  if (input[idx] == '\\' && idx + 2 < input.size() &&
+      input[idx + 1] == 'u' && input[idx + 2] == '{') {
+    auto escape_end_idx = input.find('}', idx + 3);
+    if (escape_end_idx == std::string_view::npos)
+      return input.size() - idx;
+    return escape_end_idx + 1 - idx;
+  } else if (input[idx] == '\\' && idx + 1 < input.size()) {
+    return 1 + get_character_length(input, idx + 1);
+  } else if (input[idx] != '[' || idx + 1 == input.size()) {
+    return get_character_length(input, idx);
+  }
 
+  auto class_end_idx = idx + 1;
+  if (class_end_idx < input.size() && input[class_end_idx] == '^')
+    ++class_end_idx;
+  // A ']' right after the opening bracket is a literal.
+  if (class_end_idx < input.size() && input[class_end_idx] == ']')
+    ++class_end_idx;
+  while (class_end_idx < input.size() && input[class_end_idx] != ']') {
+    if (input[class_end_idx] == '\\')
+      ++class_end_idx;
+    ++class_end_idx;
+  }
+  return std::min(class_end_idx + 1, input.size()) - idx;
+}
+
+/**
+ * The characters an atom matches. Single bytes, which are ASCII characters
+ * and bytes of the pattern that are not valid UTF-8, are kept as a byte set.
+ * Code points from U+0080 on are kept as sorted, disjoint ranges and match
+ * their UTF-8 encodings, see split_into_utf8_sequences.
+ */
+struct CharacterSet {
+  ByteSet input_bytes;
+  std::vector<CodePointRange> code_point_ranges;
+};
+
+/**
+ * Adds the code points from first to last, putting the ASCII ones in the
+ * byte set.
+ */
+constexpr void insert_code_point_range(
+    std::uint32_t first, std::uint32_t last, CharacterSet* characters) {
+  if (first > last)
+    return;
+  if (first < 0x80)
+    characters->input_bytes.insert_range(first, std::min(last, 0x7Fu));
+  if (last >= 0x80) {
+    characters->code_point_ranges.push_back(
+        {std::max(first, 0x80u), std::min(last, kMaxCodePoint)});
+  }
+}
+
+constexpr std::uint32_t kNoCodePoint = 0xFFFFFFFF;
+
+/**
+ * Returns the code point of the hex digits of a \\u{...} escape, between idx
+ * and end_idx, or kNoCodePoint if there are no digits, a digit is not hex,
+ * the code point is past kMaxCodePoint or it is a surrogate.
+ */
+constexpr std::uint32_t parse_code_point_escape(
+    std::string_view input, std::size_t idx, std::size_t end_idx) {
+  std::uint32_t code_point = 0;
+  if (idx == end_idx)
+    return kNoCodePoint;
+  for (; idx < end_idx; ++idx) {
+    auto digit = input[idx];
+    std::uint32_t digit_value = 0;
+    if (digit >= '0' && digit <= '9')
+      digit_value = digit - '0';
+    else if (digit >= 'a' && digit <= 'f')
+      digit_value = digit - 'a' + 10;
+    else if (digit >= 'A' && digit <= 'F')
+      digit_value = digit - 'A' + 10;
+    else
+      return kNoCodePoint;
+    code_point = 16 * code_point + digit_value;
+    if (code_point > kMaxCodePoint)
+      return kNoCodePoint;
+  }
+  if (code_point >= kFirstSurrogate && code_point <= kLastSurrogate)
+    return kNoCodePoint;
+  return code_point;
+}
+
+/**
+ * Returns the bytes an escaped character stands for. \\d, \\w and \\s are the
+ * usual shorthand classes, \\n, \\t and \\r are control characters and any
+ * other escaped character is itself.
+ */
+constexpr ByteSet parse_escape(char escaped_character) {
+  ByteSet input_bytes;
+  switch (escaped_character) {
+    case 'd':
+      input_bytes.insert_range('0', '9');
+      break;
+    case 'w':
+      input_bytes.insert_range('a', 'z');
+      input_bytes.insert_range('A', 'Z');
+      input_bytes.insert_range('0', '9');
+      input_bytes.insert('_');
+      break;
+    case 's':
+      for (auto space_character : {' ', '\t', '\n', '\r', '\f', '\v'})
+        input_bytes.insert(space_character);
+      break;
+    case 'n':
+      input_bytes.insert('\n');
+      break;
+    case 't':
+      input_bytes.insert('\t');
+      break;
+    case 'r':
+      input_bytes.insert('\r');
+      break;
+    default:
+      input_bytes.insert(escaped_character);
+  }
+  return input_bytes;
+}
+
+/**
+ * A member of a class: the character at idx, an escape or a code point
+ * escape. A member that is one byte or one code point has it as its value
+ * and can be a range endpoint. Atoms outside classes are parsed as members
+ * too.
+ */
+struct ClassMember {
+  CharacterSet characters;
+  std::size_t length = 1;
+  bool is_single_character = false;
+  std::uint32_t value = 0;
+  // Whether the value is a code point rather than a byte that is not
+  // valid UTF-8.
+  bool is_code_point = true;
+};
+
+constexpr ClassMember parse_class_member(
+    std::string_view atom, std::size_t idx, std::size_t class_end_idx) {
+  ClassMember member;
+  if (atom[idx] == '\\' && idx + 2 < class_end_idx && atom[idx + 1] == 'u' &&
+      atom[idx + 2] == '{') {
+    auto escape_end_idx = std::min(atom.find('}', idx + 3), class_end_idx);
+    member.length = std::min(escape_end_idx + 1, class_end_idx) - idx;
+    member.value = parse_code_point_escape(atom, idx + 3, escape_end_idx);
+    member.is_single_character = member.value != kNoCodePoint;
+  } else if (atom[idx] == '\\' && idx + 1 < class_end_idx) {
+    auto character_length = get_character_length(atom, idx + 1);
+    member.length = 1 + character_length;
+    if (character_length > 1) {
+      member.value = decode_utf8(atom, idx + 1, character_length);
+      member.is_single_character = true;
+    } else {
+      member.characters.input_bytes = parse_escape(atom[idx + 1]);
+      // Only escapes of a single byte can be range endpoints.
+      for (auto symbol = 0; symbol < 256; ++symbol) {
+        if (member.characters.input_bytes.contains(symbol)) {
+          member.is_single_character =
+              member.characters.input_bytes == ByteSet(symbol);
+          member.value = symbol;
+          member.is_code_point = symbol < 0x80;
+          break;
+        }
+      }
+      return member;
+    }
+  } else {
+    member.length = get_character_length(atom, idx);
+    member.value = static_cast<unsigned char>(atom[idx]);
+    if (member.length > 1)
+      member.value = decode_utf8(atom, idx, member.length);
+    member.is_single_character = true;
+    member.is_code_point = member.length > 1 || member.value < 0x80;
+  }
+
+  if (member.is_single_character && member.is_code_point)
+    insert_code_point_range(member.value, member.value, &member.characters);
+  else if (member.is_single_character)
+    member.characters.input_bytes.insert(member.value);
+  return member;
+}
+
+/**
+ * Parses the body of a class like [^a-z_] given the index past '['. Ranges
+ * are written first-last. A '-' at either end and a ']' right after the
+ * opening bracket are literals.
+ *
+ * A class with only single bytes is negated over bytes, so [^"] also matches
+ * bytes that are not valid UTF-8. A class with code points from U+0080 on,
+ * like [^\u{80}-\u{ff}], is negated over code points instead.
+ */
+constexpr CharacterSet parse_class(std::string_view atom, std::size_t idx) {
+  auto is_negated = idx < atom.size() && atom[idx] == '^';
+  if (is_negated)
+    ++idx;
+  auto class_end_idx = atom.size();
+  if (atom[atom.size() - 1] == ']' && atom.size() - 1 > idx)
+    class_end_idx = atom.size() - 1;
+
+  CharacterSet characters;
+  std::uint32_t range_start = 0;
+  auto is_range_start_code_point = false;
+  auto has_range_start = false;
+  auto is_range_pending = false;
+  while (idx < class_end_idx) {
+    if (atom[idx] == '-' && has_range_start && idx + 1 < class_end_idx) {
+      is_range_pending = true;
+      ++idx;
+      continue;
+    }
+    auto member = parse_class_member(atom, idx, class_end_idx);
+    idx += member.length;
+
+    if (is_range_pending && member.is_single_character) {
+      if (is_range_start_code_point || member.is_code_point) {
+        insert_code_point_range(range_start, member.value, &characters);
+      } else {
+        characters.input_bytes.insert_range(range_start, member.value);
+      }
+      has_range_start = false;
+      is_range_pending = false;
+      continue;
+    }
+    if (is_range_pending) {
+      characters.input_bytes.insert('-');
+      is_range_pending = false;
+    }
+    characters.input_bytes.insert_all(member.characters.input_bytes);
+    for (auto range : member.characters.code_point_ranges)
+      characters.code_point_ranges.push_back(range);
+    has_range_start = member.is_single_character;
+    range_start = member.value;
+    is_range_start_code_point = member.is_code_point;
+  }
+  characters.code_point_ranges =
+      normalize_code_point_ranges(std::move(characters.code_point_ranges));
+
+  if (!is_negated)
+    return characters;
+  if (characters.code_point_ranges.empty())
+    return {characters.input_bytes.complement(), {}};
+  auto code_point_ranges = std::move(characters.code_point_ranges);
+  for (std::uint32_t symbol = 0; symbol < 0x80; ++symbol) {
+    if (characters.input_bytes.contains(symbol))
+      code_point_ranges.push_back({symbol, symbol});
+  }
+  CharacterSet complement_characters;
+  for (auto range : complement_code_point_ranges(std::move(code_point_ranges)))
+    insert_code_point_range(range.first, range.last, &complement_characters);
+  return complement_characters;
+}
+
+/**
+ * Returns the characters matched by a single atom. Atoms are parsed the same
+ * way at run time and at compile time, see static_lexer.h.
+ */
+constexpr CharacterSet parse_atom(std::string_view atom) {
+  if (atom.size() > 1 && atom[0] == '[')
+    return parse_class(atom, 1);
+  return parse_class_member(atom, 0, atom.size()).characters;
+}
+
+enum class RegularExpressionNodeType { byte_set, empty, unio, concat, star };
+
+/**
+ * A node of the syntax tree of a regular expression. A byte_set node matches
+ * one byte of input_bytes and an empty node matches the empty string. The
+ * other nodes apply their operator to their operands, which are indices of
+ * other nodes. A star has no second operand.
+ */
+struct RegularExpressionNode {
+  RegularExpressionNodeType node_type;
+  ByteSet input_bytes;
+  int first_operand = -1;
+  int second_operand = -1;
+};
+
+/**
+ * The nodes of a syntax tree in postorder, so the operands of a node come
+ * before it and the last node is the root.
+ */
+using RegularExpressionTree = std::vector<RegularExpressionNode>;
+
+/**
+ * A recursive descent parser for regular expressions. Alternation with '|'
+ * binds loosest, then concatenation, then '*'. Parentheses group and the
+ * atoms are those of get_atom_length. Code points past ASCII become
+ * alternations of UTF-8 byte sequences, see add_character_set_nodes, so
+ * automata never decode UTF-8. A pattern of a single byte is
+ * always a literal, and so are a '*' with nothing to repeat and a ')' with
+ * no '(' to close. Every character is looked at once, so parsing takes
+ * linear time.
+ */
+class RegularExpressionParser {
+ private:
+  std::string_view expression_;
+  std::size_t idx_ = 0;
+  int depth_ = 0;
+  RegularExpressionTree tree_;
+
+  constexpr bool is_at(char character) const {
+    return idx_ < expression_.size() && expression_[idx_] == character;
+  }
+
+  constexpr bool is_at_concatenation_end() const {
+    return idx_ == expression_.size() || is_at('|') ||
+        (depth_ > 0 && is_at(')'));
+  }
+
+  constexpr int add_node(
+      RegularExpressionNodeType node_type, int first_operand = -1,
+      int second_operand = -1) {
+    tree_.push_back({node_type, ByteSet(), first_operand, second_operand});
+    return tree_.size() - 1;
+  }
+
+  constexpr int add_byte_set_node(const ByteSet& input_bytes) {
+    auto node = add_node(RegularExpressionNodeType::byte_set);
+    tree_[node].input_bytes = input_bytes;
+    return node;
+  }
+
+  /**
+   * Adds the union of the single bytes and of one concatenation of byte sets
+   * per UTF-8 sequence of the code points, so the automaton still reads one
+   * byte at a time. A set with no characters is an empty byte set.
+   */
+  constexpr int add_character_set_nodes(const CharacterSet& characters) {
+    auto node = -1;
+    if (!characters.input_bytes.is_empty())
+      node = add_byte_set_node(characters.input_bytes);
+    for (auto range : characters.code_point_ranges) {
+      for (const auto& sequence : split_into_utf8_sequences(range)) {
+        auto sequence_node = -1;
+        for (auto idx = 0; idx < sequence.length; ++idx) {
+          ByteSet input_bytes;
+          input_bytes.insert_range(
+              sequence.first_bytes[idx], sequence.last_bytes[idx]);
+          auto byte_node = add_byte_set_node(input_bytes);
+          sequence_node = sequence_node == -1 ? byte_node : add_node(
+              RegularExpressionNodeType::concat, sequence_node, byte_node);
+        }
+        node = node == -1 ? sequence_node : add_node(
+            RegularExpressionNodeType::unio, node, sequence_node);
+      }
+    }
+    return node == -1 ? add_byte_set_node(ByteSet()) : node;
+  }
+
+  constexpr int parse_atom_node() {
+    if (is_at('(') && idx_ + 1 < expression_.size()) {
+      ++idx_;
+      ++depth_;
+      auto node = parse_alternation();
+      --depth_;
+      if (is_at(')'))
+        ++idx_;
+      return node;
+    }
+    auto atom_length = get_atom_length(expression_, idx_);
+    auto characters = parse_atom(expression_.substr(idx_, atom_length));
+    idx_ += atom_length;
+    return add_character_set_nodes(characters);
+  }
+
+  constexpr int parse_repetition() {
+    auto node = parse_atom_node();
+    while (is_at('*')) {
+      ++idx_;
+      node = add_node(RegularExpressionNodeType::star, node);
+    }
+    return node;
+  }
+
+  constexpr int parse_concatenation() {
+    if (is_at_concatenation_end())
+      return add_node(RegularExpressionNodeType::empty);
+    auto node = parse_repetition();
+    while (!is_at_concatenation_end()) {
+      auto next_node = parse_repetition();
+      node = add_node(RegularExpressionNodeType::concat, node, next_node);
+    }
+    return node;
+  }
+
+  constexpr int parse_alternation() {
+    auto node = parse_concatenation();
+    while (is_at('|')) {
+      ++idx_;
+      auto other_node = parse_concatenation();
+      node = add_node(RegularExpressionNodeType::unio, node, other_node);
+    }
+    return node;
+  }
+
+ public:
+  constexpr explicit RegularExpressionParser(std::string_view expression)
+      :expression_{expression}
+  {}
+
+  constexpr RegularExpressionTree parse() {
+    tree_.reserve(2 * expression_.size() + 1);
+    if (expression_.size() == 1) {
+      auto node = add_node(RegularExpressionNodeType::byte_set);
+      tree_[node].input_bytes =
+          ByteSet(static_cast<unsigned char>(expression_[0]));
+    } else {
+      parse_alternation();
+    }
+    return std::move(tree_);
+  }
+};
+
+constexpr RegularExpressionTree parse_regular_expression(
+    std::string_view expression) {
+  return RegularExpressionParser(expression).parse();
+}
+
+/**
+ * The start and final state of the automaton of a syntax tree in a graph.
+ */
+struct RegularExpressionFragment {
+  int start_state;
+  int final_state;
+};
+
+/**
+ * Adds the Thompson automaton of a syntax tree to a graph. Since operands come
+ * before the nodes using them, the automata of all nodes are built in one pass
+ * over the tree without recursion.
+ */
+constexpr RegularExpressionFragment build_thompson_fragment(
+    const RegularExpressionTree& tree, TransitionGraph* graph) {
+  std::vector<RegularExpressionFragment> fragments(tree.size());
+  for (std::size_t idx = 0; idx < tree.size(); ++idx) {
+    const auto& node = tree[idx];
+    auto& fragment = fragments[idx];
+    if (node.node_type == RegularExpressionNodeType::byte_set) {
+      fragment = {graph->add_state(), graph->add_state()};
+      graph->add_transition(
+          fragment.start_state, fragment.final_state, node.input_bytes);
+    } else if (node.node_type == RegularExpressionNodeType::empty) {
+      fragment.start_state = graph->add_state();
+      fragment.final_state = fragment.start_state;
+    } else if (node.node_type == RegularExpressionNodeType::concat) {
+      const auto& first_fragment = fragments[node.first_operand];
+      const auto& second_fragment = fragments[node.second_operand];
+      graph->add_transition(
+          first_fragment.final_state, second_fragment.start_state);
+      fragment = {first_fragment.start_state, second_fragment.final_state};
+    } else if (node.node_type == RegularExpressionNodeType::unio) {
+      const auto& first_fragment = fragments[node.first_operand];
+      const auto& second_fragment = fragments[node.second_operand];
+      fragment = {graph->add_state(), graph->add_state()};
+      graph->add_transition(fragment.start_state, first_fragment.start_state);
+      graph->add_transition(fragment.start_state, second_fragment.start_state);
+      graph->add_transition(first_fragment.final_state, fragment.final_state);
+      graph->add_transition(second_fragment.final_state, fragment.final_state);
+    } else {
+      const auto& operand_fragment = fragments[node.first_operand];
+      fragment = {graph->add_state(), graph->add_state()};
+      graph->add_transition(fragment.start_state, operand_fragment.start_state);
+      graph->add_transition(fragment.start_state, fragment.final_state);
+      graph->add_transition(
+          operand_fragment.final_state, operand_fragment.start_state);
+      graph->add_transition(operand_fragment.final_state, fragment.final_state);
+    }
+  }
+  return fragments.back();
+}
+
+NonDeterministicFiniteAutomaton build_nfa(
+    const RegularExpressionTree& tree, std::shared_ptr<TransitionGraph> graph);
+
+/**
+ * A string that every match of a syntax tree contains at the same offset
+ * from the start of the match, like "ab" at offset 1 for [xy]ab*. The
+ * literal is empty if there is no such string.
+ */
+struct RequiredLiteral {
+  std::string literal;
+  std::size_t offset = 0;
+};
+
+RequiredLiteral find_required_literal(const RegularExpressionTree& tree);
+
+/**
+ * A match of RegularExpression::find_all.
+ */
+struct RegularExpressionMatch {
+  std::size_t offset;
+  std::size_t length;
+
+  bool operator==(const RegularExpressionMatch& other) const = default;
+};
+
+/**
+ * How a RegularExpression runs its automaton. An eager automaton is built
+ * whole by convert_to_dfa and minimized. A lazy one builds its states as
+ * inputs reach them, in a cache of bounded size, for patterns whose DFA
+ * would be too big to build up front.
+ */
+enum class AutomatonMode { eager, lazy };
+
+/**
+ * A regular expression parsed once into a syntax tree, from which one
+ * automaton is built and minimized, or built lazily in lazy mode.
+ *
+ * find_all searches a haystack without running the automaton at every
+ * offset. A required literal of the syntax tree is looked for first with
+ * memchr or string_view::find, and the automaton only runs where it puts
+ * the start of a match. Without one, the bytes no match starts with are
+ * skipped, with SIMD compares if they form a few ranges.
+ */
 class RegularExpression {
  private:
   std::string expression_string_;
-  std::string first_operand_;
-  RegularExpressionOperatorType operator_;
-  std::string second_operand_;
+  RegularExpressionTree tree_;
   tokenizer::DeterministicFiniteAutomaton automaton_;
+  // Only set in lazy mode. Matching builds states into its cache, so the
+  // const methods of a lazy expression must not run on several threads at
+  // once. Each copy builds its own, so copies can.
+  std::unique_ptr<LazyDeterministicFiniteAutomaton> lazy_automaton_;
+  std::size_t cache_capacity_ = 0;
+  int number_of_unminimized_states_{};
+  RequiredLiteral required_literal_;
+  // The bytes a match can start with, and the bytes it cannot start with as
+  // ranges for find_self_loop_end, unmarked if there are too many ranges.
+  ByteSet start_bytes_;
+  SelfLoop skipped_bytes_;
 
-  std::string get_first_operand();
-  RegularExpressionOperatorType get_operator();
-  std::string get_second_operand();
-  NonDeterministicFiniteAutomaton convert_to_nfa();
+  std::size_t find_candidate(std::string_view haystack, std::size_t idx) const;
+  std::unique_ptr<LazyDeterministicFiniteAutomaton> build_lazy_automaton()
+      const;
 
  public:
   RegularExpression() = default;
   explicit RegularExpression(std::string expression_string);
+  RegularExpression(
+      std::string expression_string, AutomatonMode mode,
+      std::size_t cache_capacity =
+          LazyDeterministicFiniteAutomaton::kDefaultCacheCapacity);
+  RegularExpression(const RegularExpression& other_expression);
+  RegularExpression(RegularExpression&& other_expression) = default;
+  RegularExpression& operator=(const RegularExpression& other_expression);
+  RegularExpression& operator=(RegularExpression&& other_expression) = default;
   ~RegularExpression() = default;
-  std::string match(const std::string& input);
+  NonDeterministicFiniteAutomaton convert_to_nfa();
+  NonDeterministicFiniteAutomaton convert_to_nfa(
+      std::shared_ptr<TransitionGraph> graph);
+  const RegularExpressionTree& get_tree() const;
+  std::string match(const std::string& input) const;
+  std::size_t match_length(std::string_view input, std::size_t offset) const;
+  void match_lengths(
+      std::span<const std::string_view> inputs,
+      std::span<std::size_t> match_lengths) const;
+  std::vector<RegularExpressionMatch> find_all(std::string_view haystack) const;
+  const RequiredLiteral& get_required_literal() const;
+  int get_number_of_unminimized_states();
+  int get_number_of_states();
 };
 
-int get_matching_parenthesis_index(std::string input);
-std::string trim_parenthesis(const std::string& input);
-
 };  // namespace tokenizer
 
 #endif  // TOKENIZER_REGULAR_EXPRESSION_H_
@@ -0,0 +1,285 @@
+#include "tokenizer/scanner_generator.h"
+
+#include <cctype>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace tokenizer {
+
+namespace {
+
+std::string get_state_label(int state) {
+  return "state_" + std::to_string(state);
+}
+
+/**
+ * Printable bytes other than quotes and backslashes are written as
+ * character literals, and everything else as numbers.
+ */
+std::string get_byte_literal(int symbol) {
+  if (std::isalnum(symbol) ||
+      (std::ispunct(symbol) && symbol != '\'' && symbol != '\\'))
+    return std::string("'") + static_cast<char>(symbol) + "'";
+  return std::to_string(symbol);
+}
+
+/**
+ * Appends the case labels of a group of bytes, wrapped to stay under 80
+ * columns.
+ */
+void append_case_labels(const std::vector<int>& symbols, std::string* code) {
+  std::string line = "    ";
+  for (auto symbol : symbols) {
+    auto label = "case " + get_byte_literal(symbol) + ":";
+    if (line.size() + label.size() + 1 > 80) {
+      *code += line + "\n";
+      line = "    ";
+    } else if (line.size() > 4) {
+      line += " ";
+    }
+    line += label;
+  }
+  *code += line + "\n";
+}
+
+/**
+ * Appends the block of a state. The block first records the match if the
+ * state is final, then switches on the next byte. Bytes are grouped by the
+ * state they lead to, and the largest group, usually the dead state, is
+ * left to the default label.
+ */
+void append_state_block(
+    const DeterministicFiniteAutomaton& automaton, int state,
+    bool is_targeted, std::string* code) {
+  auto byte_classes = automaton.get_byte_classes();
+  auto transition_table = automaton.get_transition_table();
+  auto final_state_tags = automaton.get_final_state_tags();
+  auto number_of_classes = automaton.get_number_of_classes();
+  auto is_start_state = state == automaton.get_start_state();
+  auto is_final = final_state_tags[state] != -1;
+
+  // Only a state entered on a byte records a match.
+  auto is_recording = is_final && is_targeted;
+  if (is_targeted)
+    *code += get_state_label(state) + ":\n";
+  if (is_recording) {
+    *code += "  match_end = cursor;\n";
+    *code += "  tag = " + std::to_string(final_state_tags[state]) + ";\n";
+  }
+  if (is_start_state && is_recording)
+    *code += get_state_label(state) + "_moves:\n";
+
+  // The symbols leading to each next state, in the order the next states
+  // first appear.
+  std::vector<int> next_states;
+  std::vector<std::vector<int>> symbols_of_next_states;
+  for (auto symbol = 0;
+       symbol < DeterministicFiniteAutomaton::kNumberOfSymbols; ++symbol) {
+    auto next_state =
+        transition_table[state * number_of_classes + byte_classes[symbol]];
+    std::size_t idx = 0;
+    while (idx < next_states.size() && next_states[idx] != next_state)
+      ++idx;
+    if (idx == next_states.size()) {
+      next_states.push_back(next_state);
+      symbols_of_next_states.emplace_back();
+    }
+    symbols_of_next_states[idx].push_back(symbol);
+  }
+  std::size_t default_idx = 0;
+  for (std::size_t idx = 1; idx < next_states.size(); ++idx) {
+    if (symbols_of_next_states[idx].size() >
+        symbols_of_next_states[default_idx].size())
+      default_idx = idx;
+  }
+  auto get_jump = [](int next_state) {
+    if (next_state == DeterministicFiniteAutomaton::kDeadState)
+      return std::string("goto done;");
+    return "goto " + get_state_label(next_state) + ";";
+  };
+
+  if (next_states.size() == 1 &&
+      next_states[0] == DeterministicFiniteAutomaton::kDeadState) {
+    *code += "  goto done;\n";
+    return;
+  }
+  *code += "  if (cursor == end)\n";
+  *code += "    goto done;\n";
+  if (next_states.size() == 1) {
+    *code += "  ++cursor;\n";
+    *code += "  " + get_jump(next_states[0]) + "\n";
+    return;
+  }
+  *code += "  switch (static_cast<unsigned char>(*cursor++)) {\n";
+  for (std::size_t idx = 0; idx < next_states.size(); ++idx) {
+    if (idx == default_idx)
+      continue;
+    append_case_labels(symbols_of_next_states[idx], code);
+    *code += "      " + get_jump(next_states[idx]) + "\n";
+  }
+  *code += "    default:\n";
+  *code += "      " + get_jump(next_states[default_idx]) + "\n";
+  *code += "  }\n";
+}
+
+/**
+ * Appends the pilots and slots of the keyword table of a program as
+ * constants, and the table that points at them.
+ */
+void append_keyword_table(const KeywordTable& keywords, std::string* code) {
+  *code += "  static constexpr std::uint32_t kKeywordPilots[] = {\n";
+  for (auto pilot : keywords.get_pilots())
+    *code += "      " + std::to_string(pilot) + ",\n";
+  *code += "  };\n";
+  *code += "  static constexpr tokenizer::KeywordSlot kKeywordSlots[] = {\n";
+  for (const auto& keyword_slot : keywords.get_slots()) {
+    std::string bytes;
+    for (std::size_t idx = 0; idx < keyword_slot.length; ++idx) {
+      if (idx != 0)
+        bytes += ", ";
+      // Keyword bytes past 0x7F are written as negative chars.
+      auto byte = static_cast<signed char>(keyword_slot.bytes[idx]);
+      bytes += std::to_string(byte);
+    }
+    *code += "      {{" + bytes + "}, " + std::to_string(keyword_slot.length) +
+        ", " + std::to_string(keyword_slot.tag) + "},\n";
+  }
+  *code += "  };\n";
+  *code += "  static const tokenizer::KeywordTable kKeywords(\n";
+  *code += "      nullptr, kKeywordPilots, kKeywordSlots);\n";
+}
+
+}  // namespace
+
+std::string generate_scanner_header(std::string_view scanner_name) {
+  std::string include_guard;
+  for (auto character : scanner_name)
+    include_guard += std::toupper(static_cast<unsigned char>(character));
+  include_guard += "_H_";
+
+  std::string code;
+  code += "// Generated by generate_scanner. Do not edit.\n\n";
+  code += "#ifndef " + include_guard + "\n";
+  code += "#define " + include_guard + "\n\n";
+  code += "#include <cstddef>\n";
+  code += "#include <cstdint>\n";
+  code += "#include <string_view>\n\n";
+  code += "#include \"tokenizer/tokenizer.h\"\n\n";
+  code += "namespace " + std::string(scanner_name) + " {\n\n";
+  code += "std::size_t find_longest_match(\n";
+  code += "    std::string_view input, std::size_t offset, "
+          "int* final_state_tag);\n";
+  code += "tokenizer::TokenBuffer tokenize_all(std::string_view source);\n\n";
+  code += "}  // namespace " + std::string(scanner_name) + "\n\n";
+  code += "#endif  // " + include_guard + "\n";
+  return code;
+}
+
+/**
+ * The start state is entered without reading a byte, so the scanner jumps
+ * past the part of its block that records a match, like find_longest_match
+ * never records an empty one. The other blocks follow in state order, and
+ * each jumps to the next state's block or to done, where the result is
+ * returned.
+ */
+std::string generate_scanner_source(
+    const LexerProgram& program, std::string_view scanner_name) {
+  const auto& automaton = program.get_automaton();
+  auto transition_table = automaton.get_transition_table();
+  auto number_of_states = automaton.get_number_of_states();
+  auto start_state = automaton.get_start_state();
+  std::vector<bool> is_targeted(number_of_states, false);
+  for (auto next_state : transition_table) {
+    if (next_state != DeterministicFiniteAutomaton::kDeadState)
+      is_targeted[next_state] = true;
+  }
+
+  std::string code;
+  code += "// Generated by generate_scanner. Do not edit.\n\n";
+  code += "#include \"" + std::string(scanner_name) + ".h\"\n\n";
+  code += "namespace " + std::string(scanner_name) + " {\n\n";
+  code += "std::size_t find_longest_match(\n";
+  code += "    std::string_view input, std::size_t offset, "
+          "int* final_state_tag) {\n";
+  code += "  const char* cursor = input.data() + offset;\n";
+  code += "  const char* end = input.data() + input.size();\n";
+  code += "  const char* match_end = cursor;\n";
+  code += "  int tag = -1;\n";
+  if (is_targeted[start_state] &&
+      automaton.get_final_state_tags()[start_state] != -1)
+    code += "  goto " + get_state_label(start_state) + "_moves;\n";
+  append_state_block(automaton, start_state, is_targeted[start_state], &code);
+  for (auto state = 0; state < number_of_states; ++state) {
+    if (state != start_state && is_targeted[state])
+      append_state_block(automaton, state, true, &code);
+  }
+  code += "done:\n";
+  code += "  *final_state_tag = tag;\n";
+  code += "  return match_end - (input.data() + offset);\n";
+  code += "}\n\n";
+
+  code += "tokenizer::TokenBuffer tokenize_all(std::string_view source) {\n";
+  code += "  static constexpr tokenizer::TokenType kTokenTypes[] = {\n";
+  for (auto token_type : program.get_token_types()) {
+    code += "      static_cast<tokenizer::TokenType>(" +
+        std::to_string(static_cast<int>(token_type)) + "),\n";
+  }
+  if (program.get_token_types().empty())
+    code += "      tokenizer::TokenType::invalid,\n";
+  code += "  };\n";
+  auto has_keywords = !program.get_keywords().is_empty();
+  if (has_keywords)
+    append_keyword_table(program.get_keywords(), &code);
+  code += "  tokenizer::TokenBuffer tokens(source);\n";
+  code += "  tokens.reserve(\n";
+  code += "      tokenizer::TokenBuffer::estimate_number_of_tokens("
+          "source.size()));\n";
+  code += "  std::size_t token_start_idx = 0;\n";
+  code += "  while (token_start_idx < source.size()) {\n";
+  code += "    int final_state_tag;\n";
+  code += "    auto lexeme_length = find_longest_match(\n";
+  code += "        source, token_start_idx, &final_state_tag);\n";
+  code += "    if (lexeme_length == 0) {\n";
+  code += "      tokens.push_back(\n";
+  code += "          tokenizer::TokenType::invalid, token_start_idx, 0);\n";
+  code += "      break;\n";
+  code += "    }\n";
+  code += "    auto token_type = kTokenTypes[final_state_tag];\n";
+  if (has_keywords) {
+    code += "    if (token_type == tokenizer::TokenType::id) {\n";
+    code += "      auto keyword_tag = kKeywords.find(\n";
+    code += "          source.substr(token_start_idx, lexeme_length));\n";
+    code += "      if (keyword_tag != -1)\n";
+    code += "        token_type = static_cast<tokenizer::TokenType>("
+            "keyword_tag);\n";
+    code += "    }\n";
+  }
+  code += "    tokens.push_back(token_type, token_start_idx, "
+          "lexeme_length);\n";
+  code += "    token_start_idx += lexeme_length;\n";
+  code += "  }\n";
+  code += "  return tokens;\n";
+  code += "}\n\n";
+  code += "}  // namespace " + std::string(scanner_name) + "\n";
+  return code;
+}
+
+/**
+ * Writes scanner_name.h and scanner_name.cc to a directory. Returns false if
+ * either cannot be written.
+ */
+bool write_scanner_files(
+    const LexerProgram& program, const std::string& scanner_name,
+    const std::string& directory) {
+  auto path_prefix = directory + "/" + scanner_name;
+  std::ofstream header_file(path_prefix + ".h", std::ios::binary);
+  header_file << generate_scanner_header(scanner_name);
+  std::ofstream source_file(path_prefix + ".cc", std::ios::binary);
+  source_file << generate_scanner_source(program, scanner_name);
+  header_file.close();
+  source_file.close();
+  return header_file.good() && source_file.good();
+}
+
+}  // namespace tokenizer
@@ -0,0 +1,39 @@
+#ifndef TOKENIZER_SCANNER_GENERATOR_H_
+#define TOKENIZER_SCANNER_GENERATOR_H_
+
+#include <string>
+#include <string_view>
+
+#include "tokenizer/tokenizer.h"
+
+namespace tokenizer {
+
+/**
+ * Generates C++ source for a scanner that runs the automaton of a lexer
+ * program as code instead of reading its tables. Every state is a labeled
+ * block that switches on the next byte and jumps to the block of the next
+ * state, so there is no transition table to load from and the compiler sees
+ * every branch.
+ *
+ * The generated header declares, in namespace scanner_name,
+ *
+ *   std::size_t find_longest_match(
+ *       std::string_view input, std::size_t offset, int* final_state_tag);
+ *   tokenizer::TokenBuffer tokenize_all(std::string_view source);
+ *
+ * which return the same as DeterministicFiniteAutomaton::find_longest_match
+ * and Tokenizer::tokenize_all do for the program. The keyword table of the
+ * program is written out as constants too, so tokenize_all reclassifies
+ * keywords without building it. The source includes the header as
+ * scanner_name.h.
+ */
+std::string generate_scanner_header(std::string_view scanner_name);
+std::string generate_scanner_source(
+    const LexerProgram& program, std::string_view scanner_name);
+bool write_scanner_files(
+    const LexerProgram& program, const std::string& scanner_name,
+    const std::string& directory);
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_SCANNER_GENERATOR_H_
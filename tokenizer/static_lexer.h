@@ -0,0 +1,129 @@
+#ifndef TOKENIZER_STATIC_LEXER_H_
+#define TOKENIZER_STATIC_LEXER_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tokenizer/finite_automaton.h"
+#include "tokenizer/regular_expression.h"
+
+namespace tokenizer {
+
+/**
+ * The tables of a minimized lexer automaton, computed by the compiler. See
+ * build_static_automaton.
+ */
+template <int kStates, int kClasses>
+struct StaticAutomaton {
+  static constexpr int kNumberOfStates = kStates;
+  static constexpr int kNumberOfClasses = kClasses;
+
+  int start_state = 0;
+  int number_of_unminimized_states = 0;
+  ByteClasses byte_classes{};
+  std::array<int, kStates * kClasses> transition_table{};
+  // -1 for states that are not final.
+  std::array<int, kStates> final_state_tags{};
+  std::array<SelfLoop, kStates> self_loops{};
+
+  /**
+   * The automaton points into this object instead of copying its tables, so
+   * this is meant to be called on constants with static storage duration.
+   */
+  DeterministicFiniteAutomaton to_automaton() const {
+    return DeterministicFiniteAutomaton(
+        nullptr, start_state, kClasses, byte_classes, transition_table,
+        final_state_tags, self_loops);
+  }
+};
+
+namespace static_lexer_internal {
+
+/**
+ * The minimized tables, and the number of states before minimization.
+ */
+struct BuiltAutomaton {
+  int number_of_unminimized_states = 0;
+  AutomatonTables tables;
+};
+
+/**
+ * Builds the same automaton as the LexerProgram constructor, with the same
+ * graph, subset construction and minimization: the fragments of all patterns
+ * come first, then a start state with an epsilon transition to each of them
+ * in order, and the final state of each fragment is tagged with its index.
+ */
+template <typename TokenDefinitions>
+constexpr BuiltAutomaton build_automaton(
+    const TokenDefinitions& token_definitions) {
+  TransitionGraph graph;
+  std::vector<RegularExpressionFragment> fragments;
+  for (const auto& token_definition : token_definitions) {
+    fragments.push_back(build_thompson_fragment(
+        parse_regular_expression(token_definition.first), &graph));
+  }
+  auto nfa_start_state = graph.add_state();
+  std::vector<int> nfa_final_state_tags(graph.get_number_of_states(), -1);
+  for (std::size_t tag = 0; tag < fragments.size(); ++tag) {
+    graph.add_transition(nfa_start_state, fragments[tag].start_state);
+    nfa_final_state_tags[fragments[tag].final_state] = tag;
+  }
+
+  auto unminimized_tables =
+      build_dfa_tables(graph, nfa_start_state, nfa_final_state_tags);
+  return {unminimized_tables.get_number_of_states(),
+          minimize_dfa_tables(unminimized_tables)};
+}
+
+}  // namespace static_lexer_internal
+
+/**
+ * Builds the lexer automaton for a fixed list of token definitions at compile
+ * time. Each definition is a pair whose first member is the pattern, and the
+ * final states of the automaton are tagged with the index of the pattern they
+ * accept, like in the Tokenizer constructor. For example,
+ *
+ *   static constexpr std::array kDefinitions = {
+ *       std::pair{std::string_view("[0-9][0-9]*"), TokenType::number}};
+ *   constexpr auto kAutomaton = build_static_automaton<kDefinitions>();
+ *
+ * The automaton is built twice, once to size the arrays of the result and
+ * once to fill them, since memory allocated in a constant expression cannot
+ * outlive it.
+ */
+template <const auto& kTokenDefinitions>
+consteval auto build_static_automaton() {
+  constexpr auto kSizes = [] {
+    auto automaton = static_lexer_internal::build_automaton(kTokenDefinitions);
+    return std::pair{automaton.tables.get_number_of_states(),
+                     automaton.tables.number_of_classes};
+  }();
+  auto automaton = static_lexer_internal::build_automaton(kTokenDefinitions);
+  const auto& tables = automaton.tables;
+
+  StaticAutomaton<kSizes.first, kSizes.second> static_automaton;
+  static_automaton.start_state = tables.start_state;
+  static_automaton.number_of_unminimized_states =
+      automaton.number_of_unminimized_states;
+  static_automaton.byte_classes = tables.byte_classes;
+  std::copy(
+      std::begin(tables.transition_table), std::end(tables.transition_table),
+      std::begin(static_automaton.transition_table));
+  std::copy(
+      std::begin(tables.final_state_tags), std::end(tables.final_state_tags),
+      std::begin(static_automaton.final_state_tags));
+  for (auto state = 0; state < kSizes.first; ++state) {
+    static_automaton.self_loops[state] = find_self_loop(
+        state, kSizes.second, static_automaton.byte_classes,
+        static_automaton.transition_table);
+  }
+  return static_automaton;
+}
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_STATIC_LEXER_H_
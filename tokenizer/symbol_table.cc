@@ -0,0 +1,123 @@
+#include "tokenizer/symbol_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tokenizer {
+
+SymbolTable::SymbolTable()
+    :slots_(kInitialNumberOfSlots, kNoSymbol)
+{}
+
+/**
+ * Mixes in 8 bytes at a time, with a multiply and a shift per word in the
+ * style of FNV-1a, since identifiers are often longer than a few bytes.
+ * The low bits of a product only depend on the low bytes of the word, and
+ * slots come from the low bits, so the result goes through the murmur3
+ * finalizer. Without it, names sharing their first 5 bytes, like value1
+ * and valueAB, would all probe from one slot.
+ */
+std::uint64_t SymbolTable::hash(std::string_view name) {
+  constexpr std::uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+  std::uint64_t name_hash = 14695981039346656037ULL ^ name.size();
+  std::size_t idx = 0;
+  for (; idx + 8 <= name.size(); idx += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, name.data() + idx, 8);
+    name_hash = (name_hash ^ word) * kMultiplier;
+    name_hash ^= name_hash >> 29;
+  }
+  if (idx < name.size()) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, name.data() + idx, name.size() - idx);
+    name_hash = (name_hash ^ word) * kMultiplier;
+    name_hash ^= name_hash >> 29;
+  }
+  name_hash ^= name_hash >> 33;
+  name_hash *= 0xFF51AFD7ED558CCDULL;
+  name_hash ^= name_hash >> 33;
+  name_hash *= 0xC4CEB9FE1A85EC53ULL;
+  name_hash ^= name_hash >> 33;
+  return name_hash;
+}
+
+/**
+ * Returns the slot holding the name, or the empty slot where it would go.
+ */
+std::size_t SymbolTable::find_slot(
+    std::string_view name, std::uint64_t name_hash) const {
+  auto slot_mask = slots_.size() - 1;
+  auto slot = static_cast<std::size_t>(name_hash) & slot_mask;
+  while (slots_[slot] != kNoSymbol) {
+    auto symbol = slots_[slot];
+    if (hashes_[symbol] == name_hash && names_[symbol] == name)
+      break;
+    slot = (slot + 1) & slot_mask;
+  }
+  return slot;
+}
+
+/**
+ * Copies a name into the current block, or into a new one if it does not
+ * fit. Names longer than a block get a block of their own. The empty name
+ * needs no storage, and there may be no block yet to point into.
+ */
+std::string_view SymbolTable::store(std::string_view name) {
+  if (name.empty())
+    return std::string_view();
+  if (block_used_size_ + name.size() > block_size_) {
+    block_size_ = std::max(kBlockSize, name.size());
+    blocks_.push_back(std::make_unique<char[]>(block_size_));
+    block_used_size_ = 0;
+  }
+  auto* stored_name = blocks_.back().get() + block_used_size_;
+  std::memcpy(stored_name, name.data(), name.size());
+  block_used_size_ += name.size();
+  return std::string_view(stored_name, name.size());
+}
+
+void SymbolTable::grow() {
+  slots_.assign(2 * slots_.size(), kNoSymbol);
+  auto slot_mask = slots_.size() - 1;
+  for (std::uint32_t symbol = 0; symbol < names_.size(); ++symbol) {
+    auto slot = static_cast<std::size_t>(hashes_[symbol]) & slot_mask;
+    while (slots_[slot] != kNoSymbol)
+      slot = (slot + 1) & slot_mask;
+    slots_[slot] = symbol;
+  }
+}
+
+/**
+ * Returns the symbol of a name, adding the name if it is new.
+ */
+std::uint32_t SymbolTable::intern(std::string_view name) {
+  auto name_hash = hash(name);
+  auto slot = find_slot(name, name_hash);
+  if (slots_[slot] != kNoSymbol)
+    return slots_[slot];
+
+  std::uint32_t symbol = names_.size();
+  names_.push_back(store(name));
+  hashes_.push_back(name_hash);
+  slots_[slot] = symbol;
+  if (2 * names_.size() > slots_.size())
+    grow();
+  return symbol;
+}
+
+/**
+ * Returns the symbol of a name, or kNoSymbol if it was never interned.
+ */
+std::uint32_t SymbolTable::find(std::string_view name) const {
+  return slots_[find_slot(name, hash(name))];
+}
+
+std::string_view SymbolTable::get_name(std::uint32_t symbol) const {
+  return names_[symbol];
+}
+
+std::size_t SymbolTable::size() const {
+  return names_.size();
+}
+
+}  // namespace tokenizer
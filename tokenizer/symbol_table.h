@@ -0,0 +1,62 @@
+#ifndef TOKENIZER_SYMBOL_TABLE_H_
+#define TOKENIZER_SYMBOL_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace tokenizer {
+
+/**
+ * Interns names into dense 32-bit symbols, numbered from 0 in the order the
+ * names are first seen. Two occurrences of one name get the same symbol, so
+ * code after the lexer compares symbols instead of strings.
+ *
+ * The table owns copies of the names in blocks that never move, so the
+ * views get_name returns stay valid as long as the table, even after it
+ * grows or is moved. Names are found by linear probing in a table of
+ * symbols kept at most half full, with the hash of each symbol stored next
+ * to it so a probe rarely compares bytes and growing never hashes names
+ * again.
+ */
+class SymbolTable {
+ public:
+  static constexpr std::uint32_t kNoSymbol = 0xFFFFFFFF;
+
+ private:
+  static constexpr std::size_t kBlockSize = 1 << 16;
+  static constexpr std::size_t kInitialNumberOfSlots = 1 << 10;
+
+  // The symbol in each slot, or kNoSymbol for empty slots. The number of
+  // slots is a power of 2.
+  std::vector<std::uint32_t> slots_;
+  std::vector<std::string_view> names_;
+  std::vector<std::uint64_t> hashes_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  std::size_t block_size_ = 0;
+  std::size_t block_used_size_ = 0;
+
+  static std::uint64_t hash(std::string_view name);
+  std::size_t find_slot(std::string_view name, std::uint64_t name_hash) const;
+  std::string_view store(std::string_view name);
+  void grow();
+
+ public:
+  SymbolTable();
+  SymbolTable(const SymbolTable& other_table) = delete;
+  SymbolTable(SymbolTable&& other_table) = default;
+  SymbolTable& operator=(const SymbolTable& other_table) = delete;
+  SymbolTable& operator=(SymbolTable&& other_table) = default;
+  ~SymbolTable() = default;
+
+  std::uint32_t intern(std::string_view name);
+  std::uint32_t find(std::string_view name) const;
+  std::string_view get_name(std::uint32_t symbol) const;
+  std::size_t size() const;
+};
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_SYMBOL_TABLE_H_
@@ -1,77 +1,350 @@
 #include "tokenizer/tokenizer.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <memory>
+#include <thread>
 #include <utility>
 
+#include "tokenizer/automaton_file.h"
+#include "tokenizer/static_lexer.h"
+
 namespace tokenizer {
 
 TokenType Token::get_token_type() {
   return token_type_;
 }
 
-std::string Token::get_lexeme() {
+std::string_view Token::get_lexeme() {
   return lexeme_;
 }
 
+/**
+ * Returns how many tokens to reserve room for up front when lexing a source
+ * of the given size. Reserving for a token per byte would commit 9 bytes of
+ * arrays per source byte, or 13 with symbols, before lexing starts. Instead
+ * we reserve for a token every kEstimatedBytesPerToken bytes with a quarter
+ * more as slack, which covers sources of short identifiers and operators
+ * down to 1.6 bytes per token, like the short-lexeme benchmark at about 1.8,
+ * so their arrays never grow while lexing. Only sources made mostly of
+ * one-byte tokens grow, once.
+ */
+std::size_t TokenBuffer::estimate_number_of_tokens(std::size_t source_size) {
+  return source_size / kEstimatedBytesPerToken * 5 / 4 + 16;
+}
+
+void TokenBuffer::reserve(std::size_t number_of_tokens) {
+  token_types_.reserve(number_of_tokens);
+  offsets_.reserve(number_of_tokens);
+  lengths_.reserve(number_of_tokens);
+  if (has_symbols_)
+    symbols_.reserve(number_of_tokens);
+}
+
+void TokenBuffer::push_back(
+    TokenType token_type, std::uint32_t offset, std::uint32_t length) {
+  token_types_.push_back(static_cast<std::uint8_t>(token_type));
+  offsets_.push_back(offset);
+  lengths_.push_back(length);
+  if (has_symbols_)
+    symbols_.push_back(SymbolTable::kNoSymbol);
+}
+
+/**
+ * Appends a token with a symbol. The buffer has to have been created with
+ * has_symbols.
+ */
+void TokenBuffer::push_back(
+    TokenType token_type, std::uint32_t offset, std::uint32_t length,
+    std::uint32_t symbol) {
+  token_types_.push_back(static_cast<std::uint8_t>(token_type));
+  offsets_.push_back(offset);
+  lengths_.push_back(length);
+  symbols_.push_back(symbol);
+}
+
+/**
+ * Appends the tokens of another buffer from first_token_idx on. Both buffers
+ * have to refer to the same source and either both have symbols or neither.
+ */
+void TokenBuffer::append(
+    const TokenBuffer& other_tokens, std::size_t first_token_idx) {
+  token_types_.insert(
+      std::end(token_types_),
+      std::begin(other_tokens.token_types_) + first_token_idx,
+      std::end(other_tokens.token_types_));
+  offsets_.insert(
+      std::end(offsets_), std::begin(other_tokens.offsets_) + first_token_idx,
+      std::end(other_tokens.offsets_));
+  lengths_.insert(
+      std::end(lengths_), std::begin(other_tokens.lengths_) + first_token_idx,
+      std::end(other_tokens.lengths_));
+  if (has_symbols_) {
+    symbols_.insert(
+        std::end(symbols_), std::begin(other_tokens.symbols_) + first_token_idx,
+        std::end(other_tokens.symbols_));
+  }
+}
+
+/**
+ * Replaces the tokens from first_token_idx up to end_token_idx with the
+ * tokens of another buffer, moves the offsets of the tokens after them by
+ * offset_shift and points the buffer at a new source. Like in append, either
+ * both buffers have symbols or neither.
+ */
+void TokenBuffer::replace(
+    std::string_view source, std::size_t first_token_idx,
+    std::size_t end_token_idx, const TokenBuffer& new_tokens,
+    std::int64_t offset_shift) {
+  source_ = source;
+  for (auto idx = end_token_idx; idx < offsets_.size(); ++idx)
+    offsets_[idx] += offset_shift;
+  // Resize the range first so the tokens after it move only once.
+  auto number_of_new_tokens = new_tokens.size();
+  auto number_of_old_tokens = end_token_idx - first_token_idx;
+  auto replace_range = [&](auto* values, const auto& new_values) {
+    auto range_start = std::begin(*values) + first_token_idx;
+    if (number_of_new_tokens < number_of_old_tokens) {
+      values->erase(
+          range_start + number_of_new_tokens,
+          range_start + number_of_old_tokens);
+    } else {
+      values->insert(
+          range_start + number_of_old_tokens,
+          number_of_new_tokens - number_of_old_tokens, 0);
+    }
+    std::copy(
+        std::begin(new_values), std::end(new_values),
+        std::begin(*values) + first_token_idx);
+  };
+  replace_range(&token_types_, new_tokens.token_types_);
+  replace_range(&offsets_, new_tokens.offsets_);
+  replace_range(&lengths_, new_tokens.lengths_);
+  if (has_symbols_)
+    replace_range(&symbols_, new_tokens.symbols_);
+}
+
+std::size_t TokenBuffer::size() const {
+  return token_types_.size();
+}
+
+std::string_view TokenBuffer::get_source() const {
+  return source_;
+}
+
+TokenType TokenBuffer::get_token_type(std::size_t idx) const {
+  return static_cast<TokenType>(token_types_[idx]);
+}
+
+std::uint32_t TokenBuffer::get_offset(std::size_t idx) const {
+  return offsets_[idx];
+}
+
+std::uint32_t TokenBuffer::get_length(std::size_t idx) const {
+  return lengths_[idx];
+}
+
+std::string_view TokenBuffer::get_lexeme(std::size_t idx) const {
+  return source_.substr(offsets_[idx], lengths_[idx]);
+}
+
+Token TokenBuffer::get_token(std::size_t idx) const {
+  return Token(get_token_type(idx), get_lexeme(idx));
+}
+
+bool TokenBuffer::has_symbols() const {
+  return has_symbols_;
+}
+
+/**
+ * Returns the symbol of a token, or SymbolTable::kNoSymbol if it is not an
+ * identifier or the buffer has no symbols.
+ */
+std::uint32_t TokenBuffer::get_symbol(std::size_t idx) const {
+  if (!has_symbols_)
+    return SymbolTable::kNoSymbol;
+  return symbols_[idx];
+}
+
+const std::vector<std::uint8_t>& TokenBuffer::get_token_types() const {
+  return token_types_;
+}
+
+const std::vector<std::uint32_t>& TokenBuffer::get_offsets() const {
+  return offsets_;
+}
+
+const std::vector<std::uint32_t>& TokenBuffer::get_lengths() const {
+  return lengths_;
+}
+
+const std::vector<std::uint32_t>& TokenBuffer::get_symbols() const {
+  return symbols_;
+}
+
+namespace {
+
+constexpr auto kBuiltInAutomaton =
+    build_static_automaton<Tokenizer::kBuiltInTokenDefinitions>();
+
+constexpr auto kBuiltInKeywordTable =
+    build_static_keyword_table<Tokenizer::kBuiltInKeywords>();
+static_assert(kBuiltInKeywordTable.is_valid);
+
+std::vector<std::pair<std::string, int>> get_keyword_tags(
+    const std::vector<std::pair<std::string, TokenType>>& keywords) {
+  std::vector<std::pair<std::string, int>> keyword_tags;
+  for (const auto& [keyword, token_type] : keywords)
+    keyword_tags.emplace_back(keyword, static_cast<int>(token_type));
+  return keyword_tags;
+}
+
+/**
+ * The program of the built-in token set, built the first time a tokenizer
+ * needs it and shared by all of them after that.
+ */
+const std::shared_ptr<const LexerProgram>& get_built_in_program() {
+  static const std::shared_ptr<const LexerProgram> kBuiltInProgram =
+      std::make_shared<const LexerProgram>();
+  return kBuiltInProgram;
+}
+
+}  // namespace
+
+/**
+ * Nothing is compiled at run time here. The tables of the built-in automaton
+ * are constants, and the automaton points straight at them.
+ */
+LexerProgram::LexerProgram()
+    :automaton_{kBuiltInAutomaton.to_automaton()},
+    number_of_unminimized_states_{
+        kBuiltInAutomaton.number_of_unminimized_states},
+    max_lookahead_{automaton_.get_max_lookahead()},
+    keywords_{kBuiltInKeywordTable.to_keyword_table()} {
+  for (const auto& token_definition : Tokenizer::kBuiltInTokenDefinitions)
+    token_types_.push_back(token_definition.second);
+}
+
+LexerProgram::LexerProgram(
+    const std::vector<std::pair<std::string, TokenType>>& token_definitions,
+    const std::vector<std::pair<std::string, TokenType>>& keywords)
+    :keywords_{get_keyword_tags(keywords)} {
+  // The automata of all token types are built in one graph.
+  auto graph = std::make_shared<TransitionGraph>();
+  std::vector<NonDeterministicFiniteAutomaton> token_automata;
+  for (const auto& token_definition : token_definitions) {
+    token_automata.push_back(build_nfa(
+        parse_regular_expression(token_definition.first), graph));
+    token_types_.push_back(token_definition.second);
+  }
+
+  NonDeterministicFiniteAutomaton combined_automaton(token_automata);
+  auto unminimized_automaton = combined_automaton.convert_to_dfa();
+  number_of_unminimized_states_ =
+      unminimized_automaton.get_number_of_states();
+  automaton_ = unminimized_automaton.minimize();
+  max_lookahead_ = automaton_.get_max_lookahead();
+}
+
+/**
+ * Wraps an automaton built elsewhere, like one mapped from a file. The tag
+ * of each final state is an index into token_types, and the tags of the
+ * keywords are token types.
+ */
+LexerProgram::LexerProgram(
+    DeterministicFiniteAutomaton automaton, int number_of_unminimized_states,
+    std::vector<TokenType> token_types, KeywordTable keywords)
+    :automaton_{std::move(automaton)},
+    number_of_unminimized_states_{number_of_unminimized_states},
+    max_lookahead_{automaton_.get_max_lookahead()},
+    token_types_{std::move(token_types)},
+    keywords_{std::move(keywords)}
+{}
+
+/**
+ * Returns the token type of a lexeme the automaton accepted in a final
+ * state with the given tag, which is the keyword's if it is an identifier
+ * that is a keyword.
+ */
+TokenType LexerProgram::get_token_type(
+    int final_state_tag, std::string_view lexeme) const {
+  auto token_type = token_types_[final_state_tag];
+  if (token_type != TokenType::id)
+    return token_type;
+  auto keyword_tag = keywords_.find(lexeme);
+  return keyword_tag == -1 ? token_type : static_cast<TokenType>(keyword_tag);
+}
+
+const DeterministicFiniteAutomaton& LexerProgram::get_automaton() const {
+  return automaton_;
+}
+
+int LexerProgram::get_number_of_unminimized_states() const {
+  return number_of_unminimized_states_;
+}
+
+int LexerProgram::get_max_lookahead() const {
+  return max_lookahead_;
+}
+
+const std::vector<TokenType>& LexerProgram::get_token_types() const {
+  return token_types_;
+}
+
+const KeywordTable& LexerProgram::get_keywords() const {
+  return keywords_;
+}
+
+/**
+ * Returns false if the program was built from keywords that cannot all be
+ * looked up, see KeywordTable::is_valid. Such a program still tokenizes, but
+ * identifiers that spell a left out keyword stay identifiers.
+ */
+bool LexerProgram::is_valid() const {
+  return keywords_.is_valid();
+}
+
 Tokenizer::Tokenizer()
-    :current_input_idx_{0}, has_more_{false} {
-  RegularExpression regex_for_id("(a|b|c|d|e|f|g|h|i|j|k|l"
-                                 "|m|n|o|p|q|r|s|t|u|v|w|x|y|z)"
-                                 "(a|b|c|d|e|f|g|h|i|j|k|l|m|"
-                                 "n|o|p|q|r|s|t|u|v|w|x|y|z"
-                                 "|0|1|2|3|4|5|6|7|8|9)*");
-  RegularExpression regex_for_number("(0|1|2|3|4|5|6|7|8|9)"
-                                     "(0|1|2|3|4|5|6|7|8|9)*");
-  RegularExpression regex_for_plus("+");
-  RegularExpression regex_for_minus("-");
-  RegularExpression regex_for_star("*");
-  RegularExpression regex_for_slash("/");
-  RegularExpression regex_for_equals("=");
-  RegularExpression regex_for_double_equals("==");
-  RegularExpression regex_for_open_paren("(");
-  RegularExpression regex_for_closed_paren(")");
-
-  regular_expressions_.push_back(regex_for_id);
-  token_types_.push_back(TokenType::id);
-  regular_expressions_.push_back(regex_for_number);
-  token_types_.push_back(TokenType::number);
-  regular_expressions_.push_back(regex_for_plus);
-  token_types_.push_back(TokenType::plus);
-  regular_expressions_.push_back(regex_for_minus);
-  token_types_.push_back(TokenType::minus);
-  regular_expressions_.push_back(regex_for_star);
-  token_types_.push_back(TokenType::star);
-  regular_expressions_.push_back(regex_for_slash);
-  token_types_.push_back(TokenType::slash);
-  regular_expressions_.push_back(regex_for_equals);
-  token_types_.push_back(TokenType::equals);
-  regular_expressions_.push_back(regex_for_double_equals);
-  token_types_.push_back(TokenType::double_equals);
-  regular_expressions_.push_back(regex_for_open_paren);
-  token_types_.push_back(TokenType::open_paren);
-  regular_expressions_.push_back(regex_for_closed_paren);
-  token_types_.push_back(TokenType::closed_paren);
-}
-
-void Tokenizer::tokenize(std::string input) {
-  input_ = std::move(input);
+    :Tokenizer(get_built_in_program())
+{}
+
+Tokenizer::Tokenizer(
+    const std::vector<std::pair<std::string, TokenType>>& token_definitions,
+    const std::vector<std::pair<std::string, TokenType>>& keywords)
+    :Tokenizer(
+        std::make_shared<const LexerProgram>(token_definitions, keywords))
+{}
+
+Tokenizer::Tokenizer(std::shared_ptr<const LexerProgram> program)
+    :program_{std::move(program)}, current_input_idx_{0}, has_more_{false}
+{}
+
+void Tokenizer::tokenize(std::string_view input) {
+  input_ = input;
+  current_input_idx_ = 0;
   has_more_ = true;
 }
 
+/**
+ * Runs the combined automaton from the current position until it dies,
+ * remembering the last position where it accepted. The tag of that final
+ * state tells the token type.
+ */
 Token Tokenizer::get_next_token() {
-  std::string lexeme;
   TokenType token_type = TokenType::invalid;
-
-  auto input_to_match = input_.substr(current_input_idx_);
-  for (auto idx = 0; idx < regular_expressions_.size(); ++idx) {
-    auto regex = regular_expressions_[idx];
-    auto candidate_lexeme = regex.match(input_to_match);
-    if (candidate_lexeme.size() > lexeme.size()) {
-      lexeme = candidate_lexeme;
-      token_type = token_types_[idx];
-    }
+  int final_state_tag;
+  auto lexeme_length = program_->get_automaton().find_longest_match(
+      input_, current_input_idx_, &final_state_tag);
+  if (lexeme_length != 0) {
+    token_type = program_->get_token_type(
+        final_state_tag, input_.substr(current_input_idx_, lexeme_length));
   }
 
-  current_input_idx_ = current_input_idx_ + lexeme.size();
+  auto lexeme = input_.substr(current_input_idx_, lexeme_length);
+  current_input_idx_ = current_input_idx_ + lexeme_length;
   if (lexeme.empty() || current_input_idx_ == input_.size()) {
     has_more_ = false;
   }
@@ -84,4 +357,438 @@ bool Tokenizer::has_more() {
   return has_more_;
 }
 
+/**
+ * Tokenize a whole input into a TokenBuffer in one loop. Like
+ * get_next_token, we stop after an invalid token with an empty lexeme if
+ * the input at some point matches no token type.
+ */
+TokenBuffer Tokenizer::tokenize_all(std::string_view source) const {
+  TokenBuffer tokens(source);
+  tokens.reserve(TokenBuffer::estimate_number_of_tokens(source.size()));
+  tokenize_range(source, 0, source.size(), &tokens);
+  return tokens;
+}
+
+/**
+ * Same as tokenize_all, and also interns the lexeme of every identifier into
+ * a symbol table, which the tokens then store the symbols of. Interning
+ * costs one lookup in the table per identifier, and code after the lexer
+ * compares identifiers by symbol.
+ */
+TokenBuffer Tokenizer::tokenize_all(
+    std::string_view source, SymbolTable* symbol_table) const {
+  TokenBuffer tokens(source, true);
+  tokens.reserve(TokenBuffer::estimate_number_of_tokens(source.size()));
+  tokenize_range(source, 0, source.size(), &tokens, symbol_table);
+  return tokens;
+}
+
+/**
+ * Appends the tokens that start from start_idx up to end_idx, the last of
+ * which may end past end_idx. Only reads the program, so threads can
+ * tokenize ranges of one source at the same time, as long as they intern
+ * into different symbol tables or none.
+ */
+void Tokenizer::tokenize_range(
+    std::string_view source, std::size_t start_idx, std::size_t end_idx,
+    TokenBuffer* tokens, SymbolTable* symbol_table) const {
+  const auto& automaton = program_->get_automaton();
+  auto token_start_idx = start_idx;
+  while (token_start_idx < end_idx) {
+    int final_state_tag;
+    auto lexeme_length = automaton.find_longest_match(
+        source, token_start_idx, &final_state_tag);
+    if (lexeme_length == 0) {
+      tokens->push_back(TokenType::invalid, token_start_idx, 0);
+      break;
+    }
+    push_token(
+        final_state_tag, token_start_idx, lexeme_length, tokens,
+        symbol_table);
+    token_start_idx += lexeme_length;
+  }
+}
+
+/**
+ * Appends the token of a match, with the symbol of its lexeme if there is a
+ * symbol table and the token is an identifier. Keywords are not interned.
+ */
+void Tokenizer::push_token(
+    int final_state_tag, std::size_t offset, std::size_t length,
+    TokenBuffer* tokens, SymbolTable* symbol_table) const {
+  auto token_type = program_->get_token_type(
+      final_state_tag, tokens->get_source().substr(offset, length));
+  if (symbol_table != nullptr && token_type == TokenType::id) {
+    tokens->push_back(
+        token_type, offset, length,
+        symbol_table->intern(tokens->get_source().substr(offset, length)));
+  } else {
+    tokens->push_back(token_type, offset, length);
+  }
+}
+
+/**
+ * Tokenize a whole input like tokenize_all, with the input split into one
+ * chunk per thread.
+ *
+ * Only the first chunk is known to start at a token. The automaton is back
+ * in its start state at every token boundary, so all a chunk's thread has to
+ * guess is where its first token starts, and it guesses the first byte of
+ * the chunk. Once the true tokenization and a guessed one start a token at
+ * the same position they agree on every token after it. So we walk the
+ * chunks in order, carrying the end of the last true token over: where it
+ * is a token start of the next chunk, that chunk's tokens are taken from
+ * there on as they are. Otherwise we lex again from there, one token at a
+ * time, until we reach one of its token starts or leave the chunk. For most
+ * token sets that takes a token or two.
+ *
+ * The result is the same as that of tokenize_all, token for token.
+ */
+TokenBuffer Tokenizer::tokenize_all_parallel(
+    std::string_view source, int number_of_threads,
+    std::size_t min_chunk_size) const {
+  std::size_t number_of_chunks = std::min<std::size_t>(
+      std::max(number_of_threads, 1),
+      source.size() / std::max<std::size_t>(min_chunk_size, 1));
+  if (number_of_chunks <= 1)
+    return tokenize_all(source);
+
+  std::vector<std::size_t> chunk_starts(number_of_chunks + 1);
+  for (std::size_t chunk = 0; chunk <= number_of_chunks; ++chunk)
+    chunk_starts[chunk] = source.size() * chunk / number_of_chunks;
+  std::vector<TokenBuffer> chunk_tokens(number_of_chunks, TokenBuffer(source));
+  auto tokenize_chunk = [&](std::size_t chunk) {
+    // The tokens of the first chunk are always right and become the result,
+    // so there is room for the tokens of the whole source after them.
+    chunk_tokens[chunk].reserve(TokenBuffer::estimate_number_of_tokens(
+        chunk == 0 ? source.size()
+                   : chunk_starts[chunk + 1] - chunk_starts[chunk]));
+    tokenize_range(
+        source, chunk_starts[chunk], chunk_starts[chunk + 1],
+        &chunk_tokens[chunk]);
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t chunk = 1; chunk < number_of_chunks; ++chunk)
+    threads.emplace_back(tokenize_chunk, chunk);
+  tokenize_chunk(0);
+  for (auto& thread : threads)
+    thread.join();
+
+  const auto& automaton = program_->get_automaton();
+  auto tokens = std::move(chunk_tokens[0]);
+  auto last_token_idx = tokens.size() - 1;
+  if (tokens.get_length(last_token_idx) == 0)
+    return tokens;  // The first chunk ends with an invalid token.
+  std::size_t token_start_idx =
+      tokens.get_offset(last_token_idx) + tokens.get_length(last_token_idx);
+  for (std::size_t chunk = 1; chunk < number_of_chunks; ++chunk) {
+    const auto& guessed_offsets = chunk_tokens[chunk].get_offsets();
+    std::size_t guessed_idx = std::lower_bound(
+        std::begin(guessed_offsets), std::end(guessed_offsets),
+        token_start_idx) - std::begin(guessed_offsets);
+    while (token_start_idx < chunk_starts[chunk + 1] &&
+           (guessed_idx == guessed_offsets.size() ||
+            guessed_offsets[guessed_idx] != token_start_idx)) {
+      int final_state_tag;
+      auto lexeme_length = automaton.find_longest_match(
+          source, token_start_idx, &final_state_tag);
+      if (lexeme_length == 0) {
+        tokens.push_back(TokenType::invalid, token_start_idx, 0);
+        return tokens;
+      }
+      push_token(
+          final_state_tag, token_start_idx, lexeme_length, &tokens, nullptr);
+      token_start_idx += lexeme_length;
+      while (guessed_idx < guessed_offsets.size() &&
+             guessed_offsets[guessed_idx] < token_start_idx)
+        ++guessed_idx;
+    }
+    if (token_start_idx >= chunk_starts[chunk + 1])
+      continue;
+
+    tokens.append(chunk_tokens[chunk], guessed_idx);
+    last_token_idx = chunk_tokens[chunk].size() - 1;
+    if (chunk_tokens[chunk].get_length(last_token_idx) == 0)
+      break;  // The chunk ends with an invalid token.
+    token_start_idx = chunk_tokens[chunk].get_offset(last_token_idx) +
+        chunk_tokens[chunk].get_length(last_token_idx);
+  }
+  return tokens;
+}
+
+/**
+ * Updates the tokens of a source after an edit, lexing again only around the
+ * edit. edited_source is the source with the edit applied, and the tokens
+ * come out the same as those tokenize_all would return for it.
+ *
+ * A token that ends more than the max lookahead bytes before the edit was
+ * matched without reading any edited byte, and neither was any token before
+ * it. So we lex again from the first token that may have read an edited byte,
+ * found by binary search, and stop at the first new token past the inserted
+ * text that starts where an old token started. Lexing from there only reads
+ * bytes the edit did not touch, so the old tokens from there on only move by
+ * the change in length. Lexing stops there too if it hits an invalid token.
+ * The time spent lexing is proportional to the damaged region, though moving
+ * the offsets of the tokens after it takes a pass over them.
+ *
+ * Token sets where a failed match can read arbitrarily far, see
+ * DeterministicFiniteAutomaton::get_max_lookahead, are lexed again from the
+ * start of the source.
+ *
+ * Tokens with symbols need the symbol table they were interned into, and
+ * the new identifiers are interned into it too.
+ */
+void Tokenizer::retokenize(
+    TokenBuffer* tokens, std::string_view edited_source,
+    const TextEdit& edit, SymbolTable* symbol_table) const {
+  const auto& automaton = program_->get_automaton();
+  auto max_lookahead = program_->get_max_lookahead();
+  const auto& offsets = tokens->get_offsets();
+  const auto& lengths = tokens->get_lengths();
+  std::int64_t offset_shift = static_cast<std::int64_t>(
+      edit.inserted_text.size()) - static_cast<std::int64_t>(
+          edit.deleted_length);
+  auto inserted_text_end_idx = edit.offset + edit.inserted_text.size();
+
+  std::size_t first_token_idx = 0;
+  if (max_lookahead != -1) {
+    std::size_t end_token_idx = tokens->size();
+    while (first_token_idx < end_token_idx) {
+      auto token_idx = first_token_idx + (end_token_idx - first_token_idx) / 2;
+      if (offsets[token_idx] + lengths[token_idx] + max_lookahead <=
+          edit.offset)
+        first_token_idx = token_idx + 1;
+      else
+        end_token_idx = token_idx;
+    }
+  }
+  if (first_token_idx == tokens->size() && tokens->size() != 0) {
+    // The old tokens end in an invalid token before the edit.
+    tokens->replace(
+        edited_source, first_token_idx, first_token_idx,
+        TokenBuffer(edited_source, tokens->has_symbols()), 0);
+    return;
+  }
+
+  TokenBuffer new_tokens(edited_source, tokens->has_symbols());
+  auto old_token_idx = first_token_idx;
+  auto end_token_idx = tokens->size();
+  std::size_t token_start_idx =
+      tokens->size() == 0 ? 0 : offsets[first_token_idx];
+  while (token_start_idx < edited_source.size()) {
+    if (token_start_idx >= inserted_text_end_idx) {
+      auto old_token_start_idx =
+          static_cast<std::int64_t>(token_start_idx) - offset_shift;
+      while (old_token_idx < tokens->size() &&
+             offsets[old_token_idx] < old_token_start_idx)
+        ++old_token_idx;
+      if (old_token_idx < tokens->size() &&
+          offsets[old_token_idx] == old_token_start_idx) {
+        end_token_idx = old_token_idx;
+        break;
+      }
+    }
+
+    int final_state_tag;
+    auto lexeme_length = automaton.find_longest_match(
+        edited_source, token_start_idx, &final_state_tag);
+    if (lexeme_length == 0) {
+      new_tokens.push_back(TokenType::invalid, token_start_idx, 0);
+      break;
+    }
+    push_token(
+        final_state_tag, token_start_idx, lexeme_length, &new_tokens,
+        symbol_table);
+    token_start_idx += lexeme_length;
+  }
+  tokens->replace(
+      edited_source, first_token_idx, end_token_idx, new_tokens, offset_shift);
+}
+
+/**
+ * Tokenize an input that is read a chunk at a time.
+ *
+ * We keep a window holding the bytes from the start of the current token up
+ * to the end of the last chunk read. When the automaton runs off the end of
+ * the window while still alive, the bytes before the token are dropped and
+ * the next chunk is appended, and scanning carries on from the same
+ * cursor state. A lexeme split across two chunks is matched as if the
+ * input were contiguous, and the window never grows beyond a chunk plus the
+ * longest token and the lookahead needed to finish it.
+ *
+ * Like get_next_token, we stop after reporting an invalid token with an
+ * empty lexeme if the input at some point matches no token type.
+ *
+ * Returns false if a read failed. The tokens reported before then are the
+ * tokens of the input read so far, and the rest of the input is not lexed.
+ */
+bool Tokenizer::tokenize_chunks(
+    const ChunkReader& read_chunk, const TokenCallback& on_token,
+    std::size_t chunk_size) const {
+  AutomatonCursor cursor(program_->get_automaton());
+  std::string window;
+  window.reserve(2 * chunk_size);
+  // Offset of the first byte of the window in the stream.
+  std::size_t window_offset = 0;
+  std::size_t token_start_idx = 0;
+  std::size_t scan_idx = 0;
+  std::size_t lexeme_length = 0;
+  int final_state_tag = -1;
+  bool is_end_of_input = false;
+
+  cursor.reset();
+  while (true) {
+    if (scan_idx == window.size() && !is_end_of_input) {
+      window.erase(0, token_start_idx);
+      window_offset += token_start_idx;
+      scan_idx -= token_start_idx;
+      token_start_idx = 0;
+
+      auto old_window_size = window.size();
+      window.resize(old_window_size + chunk_size);
+      auto bytes_read = read_chunk(window.data() + old_window_size, chunk_size);
+      if (bytes_read < 0)
+        return false;
+      window.resize(old_window_size + bytes_read);
+      is_end_of_input = bytes_read == 0;
+      continue;
+    }
+
+    if (scan_idx < window.size()) {
+      cursor.move(window[scan_idx++]);
+      if (cursor.has_accepted()) {
+        lexeme_length = scan_idx - token_start_idx;
+        final_state_tag = cursor.get_final_state_tag();
+      }
+      if (!cursor.is_dead()) {
+        continue;
+      }
+    } else if (token_start_idx == window.size()) {
+      // The input ended right after a token.
+      return true;
+    }
+
+    // The automaton died or the input ended in the middle of a token.
+    if (lexeme_length == 0) {
+      on_token(Token(TokenType::invalid, ""), window_offset + token_start_idx);
+      return true;
+    }
+    std::string_view lexeme(window.data() + token_start_idx, lexeme_length);
+    on_token(Token(program_->get_token_type(final_state_tag, lexeme), lexeme),
+             window_offset + token_start_idx);
+    token_start_idx += lexeme_length;
+    scan_idx = token_start_idx;
+    lexeme_length = 0;
+    cursor.reset();
+  }
+}
+
+/**
+ * Tokenizes a stream, see tokenize_chunks. Returns false if the stream
+ * failed with an error other than reaching its end.
+ */
+bool Tokenizer::tokenize_stream(
+    std::istream& input, const TokenCallback& on_token,
+    std::size_t chunk_size) const {
+  return tokenize_chunks(
+      [&input](char* buffer, std::size_t size) -> std::ptrdiff_t {
+        input.read(buffer, size);
+        if (input.bad())
+          return -1;
+        return input.gcount();
+      },
+      on_token, chunk_size);
+}
+
+/**
+ * Tokenizes what can be read from a file descriptor, see tokenize_chunks.
+ * Returns false if a read failed with an error other than EINTR, like EIO or
+ * EBADF, instead of taking it for the end of the input.
+ */
+bool Tokenizer::tokenize_stream(
+    int file_descriptor, const TokenCallback& on_token,
+    std::size_t chunk_size) const {
+  return tokenize_chunks(
+      [file_descriptor](char* buffer, std::size_t size) -> std::ptrdiff_t {
+        while (true) {
+          auto bytes_read = read(file_descriptor, buffer, size);
+          if (bytes_read >= 0)
+            return bytes_read;
+          if (errno != EINTR)
+            return -1;
+        }
+      },
+      on_token, chunk_size);
+}
+
+/**
+ * Saves the automaton, the token types and the keywords of the program of
+ * this tokenizer to a file. See write_automaton_file. Returns false if the
+ * file cannot be written.
+ */
+bool Tokenizer::save(const std::string& path) const {
+  std::vector<int> tag_values;
+  for (auto token_type : program_->get_token_types())
+    tag_values.push_back(static_cast<int>(token_type));
+  return write_automaton_file(
+      path, program_->get_automaton(),
+      program_->get_number_of_unminimized_states(), tag_values,
+      program_->get_keywords());
+}
+
+/**
+ * Replaces the program of this tokenizer with one whose automaton and token
+ * types are saved to a file. The file is mapped into memory rather than
+ * read, see map_automaton_file. Other tokenizers sharing the old program
+ * keep it. Returns false and leaves the tokenizer unchanged if the file
+ * cannot be loaded.
+ */
+bool Tokenizer::load(const std::string& path) {
+  DeterministicFiniteAutomaton automaton;
+  int number_of_unminimized_states;
+  std::vector<int> tag_values;
+  KeywordTable keywords;
+  if (!map_automaton_file(
+          path, &automaton, &number_of_unminimized_states, &tag_values,
+          &keywords))
+    return false;
+
+  auto is_token_type = [](int tag_value) {
+    return tag_value >= 0 && tag_value < static_cast<int>(TokenType::invalid);
+  };
+  std::vector<TokenType> token_types;
+  for (auto tag_value : tag_values) {
+    if (!is_token_type(tag_value))
+      return false;
+    token_types.push_back(static_cast<TokenType>(tag_value));
+  }
+  for (const auto& keyword_slot : keywords.get_slots()) {
+    if (keyword_slot.length != 0 && !is_token_type(keyword_slot.tag))
+      return false;
+  }
+  program_ = std::make_shared<const LexerProgram>(
+      std::move(automaton), number_of_unminimized_states,
+      std::move(token_types), std::move(keywords));
+  input_ = {};
+  current_input_idx_ = 0;
+  has_more_ = false;
+  return true;
+}
+
+std::shared_ptr<const LexerProgram> Tokenizer::get_program() const {
+  return program_;
+}
+
+int Tokenizer::get_number_of_unminimized_states() const {
+  return program_->get_number_of_unminimized_states();
+}
+
+int Tokenizer::get_number_of_states() const {
+  return program_->get_automaton().get_number_of_states();
+}
+
+int Tokenizer::get_number_of_classes() const {
+  return program_->get_automaton().get_number_of_classes();
+}
+
 }  // namespace tokenizer
@@ -1,46 +1,282 @@
 #ifndef TOKENIZER_TOKENIZER_H_
 #define TOKENIZER_TOKENIZER_H_
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
+#include "tokenizer/keyword_table.h"
 #include "tokenizer/regular_expression.h"
+#include "tokenizer/symbol_table.h"
 
 namespace tokenizer {
 
 enum class TokenType {
   id, number, plus, minus, star, slash, equals, double_equals,
-  open_paren, closed_paren, dollar, invalid};
+  open_paren, closed_paren, if_keyword, else_keyword, while_keyword,
+  for_keyword, let_keyword, fn_keyword, return_keyword, dollar, invalid};
 
+/**
+ * A token does not own its lexeme. It is a view into the input the token was
+ * read from, so that input has to outlive the token.
+ */
 class Token {
  private:
   TokenType token_type_;
-  std::string lexeme_;
+  std::string_view lexeme_;
 
  public:
-  Token(TokenType token_type, std::string lexeme)
-    :token_type_{token_type}, lexeme_{std::move(lexeme)}
+  Token(TokenType token_type, std::string_view lexeme)
+    :token_type_{token_type}, lexeme_{lexeme}
   {}
   ~Token() = default;
   TokenType get_token_type();
-  std::string get_lexeme();
+  std::string_view get_lexeme();
 };
 
-class Tokenizer {
+/**
+ * The tokens of one input, stored as parallel arrays of token types, lexeme
+ * offsets and lexeme lengths instead of one Token per entry. Like Token, it
+ * does not own the input it refers to. Offsets are 32 bit, so inputs must be
+ * smaller than 4 GiB. A LineIndex of the source turns offsets into lines and
+ * columns.
+ *
+ * A buffer created with has_symbols also stores a symbol per token, which is
+ * the symbol of the lexeme in a SymbolTable for identifiers and
+ * SymbolTable::kNoSymbol for other tokens. See Tokenizer::tokenize_all.
+ */
+class TokenBuffer {
+ public:
+  // Lexemes of dense sources, counting operators and one-byte punctuation,
+  // average about 2 bytes. See estimate_number_of_tokens.
+  static constexpr std::size_t kEstimatedBytesPerToken = 2;
+
  private:
-  std::vector<RegularExpression> regular_expressions_;
+  std::string_view source_;
+  bool has_symbols_ = false;
+  std::vector<std::uint8_t> token_types_;
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uint32_t> lengths_;
+  // Empty unless has_symbols_.
+  std::vector<std::uint32_t> symbols_;
+
+ public:
+  TokenBuffer() = default;
+  explicit TokenBuffer(std::string_view source, bool has_symbols = false)
+    :source_{source}, has_symbols_{has_symbols}
+  {}
+  TokenBuffer(const TokenBuffer& other_tokens) = default;
+  TokenBuffer(TokenBuffer&& other_tokens) = default;
+  TokenBuffer& operator=(const TokenBuffer& other_tokens) = default;
+  TokenBuffer& operator=(TokenBuffer&& other_tokens) = default;
+  ~TokenBuffer() = default;
+
+  static std::size_t estimate_number_of_tokens(std::size_t source_size);
+  void reserve(std::size_t number_of_tokens);
+  void push_back(
+      TokenType token_type, std::uint32_t offset, std::uint32_t length);
+  void push_back(
+      TokenType token_type, std::uint32_t offset, std::uint32_t length,
+      std::uint32_t symbol);
+  void append(const TokenBuffer& other_tokens, std::size_t first_token_idx);
+  void replace(
+      std::string_view source, std::size_t first_token_idx,
+      std::size_t end_token_idx, const TokenBuffer& new_tokens,
+      std::int64_t offset_shift);
+  std::size_t size() const;
+  std::string_view get_source() const;
+  TokenType get_token_type(std::size_t idx) const;
+  std::uint32_t get_offset(std::size_t idx) const;
+  std::uint32_t get_length(std::size_t idx) const;
+  std::string_view get_lexeme(std::size_t idx) const;
+  Token get_token(std::size_t idx) const;
+  bool has_symbols() const;
+  std::uint32_t get_symbol(std::size_t idx) const;
+  const std::vector<std::uint8_t>& get_token_types() const;
+  const std::vector<std::uint32_t>& get_offsets() const;
+  const std::vector<std::uint32_t>& get_lengths() const;
+  const std::vector<std::uint32_t>& get_symbols() const;
+};
+
+/**
+ * An edit of a text: deleted_length bytes from offset on are replaced with
+ * inserted_text.
+ */
+struct TextEdit {
+  std::size_t offset;
+  std::size_t deleted_length;
+  std::string_view inserted_text;
+};
+
+/**
+ * A compiled token set: the lexer automaton, the token type each of its tags
+ * stands for and what the tokenizer needs to know about it. The regular
+ * expressions of all token types are compiled into a single automaton whose
+ * final states are tagged with the token type they accept. When a lexeme
+ * matches several token types, the one declared first wins.
+ *
+ * Keywords are not token definitions. They are a set of words, each with
+ * its own token type, kept in a perfect hash next to the automaton. An
+ * identifier, a token of type TokenType::id, whose lexeme is a keyword takes
+ * the token type of the keyword instead. So keywords add no states to the
+ * automaton, always win over the identifier pattern without depending on
+ * the order of the definitions, and cost one lookup per identifier however
+ * many there are. See KeywordTable.
+ *
+ * A program never changes once built, so one program can be shared by any
+ * number of tokenizers on any number of threads. See Tokenizer.
+ */
+class LexerProgram {
+ private:
+  DeterministicFiniteAutomaton automaton_;
+  int number_of_unminimized_states_;
+  // See DeterministicFiniteAutomaton::get_max_lookahead.
+  int max_lookahead_;
   std::vector<TokenType> token_types_;
-  std::string input_;
-  int current_input_idx_;
+  // Tags are token types.
+  KeywordTable keywords_;
+
+ public:
+  LexerProgram();
+  explicit LexerProgram(
+      const std::vector<std::pair<std::string, TokenType>>& token_definitions,
+      const std::vector<std::pair<std::string, TokenType>>& keywords = {});
+  LexerProgram(
+      DeterministicFiniteAutomaton automaton, int number_of_unminimized_states,
+      std::vector<TokenType> token_types,
+      KeywordTable keywords = KeywordTable());
+  ~LexerProgram() = default;
+
+  TokenType get_token_type(
+      int final_state_tag, std::string_view lexeme) const;
+  const DeterministicFiniteAutomaton& get_automaton() const;
+  int get_number_of_unminimized_states() const;
+  int get_max_lookahead() const;
+  const std::vector<TokenType>& get_token_types() const;
+  const KeywordTable& get_keywords() const;
+  bool is_valid() const;
+};
+
+/**
+ * Splits an input into tokens by maximal munch with a LexerProgram.
+ *
+ * A tokenizer is a cursor over a shared, immutable program: all it owns is
+ * the position of get_next_token in its input. Tokenizers built from one
+ * program with Tokenizer(std::shared_ptr<const LexerProgram>) cost no
+ * compilation, and each thread can scan with its own at the same time. The
+ * const methods do not touch the cursor, so they can also be called on one
+ * tokenizer from several threads. All default-constructed tokenizers share
+ * the program of the built-in token set.
+ *
+ * The tokenizer matches in place on the input it is given and does not copy
+ * it. The input has to outlive the tokenizer and the tokens read from it.
+ *
+ * Large inputs can be split between threads, see tokenize_all_parallel.
+ * After an edit, the tokens of a source can be updated instead of read
+ * again, see retokenize.
+ * Inputs too large to hold in memory can be streamed instead. See
+ * tokenize_stream.
+ *
+ * A tokenizer for a custom token set can be compiled once and saved, and
+ * other processes load it without compiling anything. See save and load.
+ */
+class Tokenizer {
+ public:
+  // Called with every token of a streamed input and the offset of its lexeme
+  // in the stream. The lexeme is only valid during the call.
+  using TokenCallback = std::function<void(Token token, std::size_t offset)>;
+  // Reads up to the given number of bytes into the buffer and returns how
+  // many were read, 0 at the end of the input or -1 if reading failed.
+  using ChunkReader =
+      std::function<std::ptrdiff_t(char* buffer, std::size_t size)>;
+
+  static constexpr std::size_t kDefaultChunkSize = 1 << 16;
+  // tokenize_all_parallel gives each thread at least this many bytes.
+  static constexpr std::size_t kMinParallelChunkSize = 1 << 18;
+
+  // The token types of the language. Their automaton is built at compile
+  // time, see build_static_automaton. Identifiers may use any code point
+  // past ASCII, as long as it is valid UTF-8.
+  static constexpr std::array<std::pair<std::string_view, TokenType>, 10>
+      kBuiltInTokenDefinitions = {{
+          {"[a-z\\u{80}-\\u{10ffff}][a-z0-9\\u{80}-\\u{10ffff}]*",
+           TokenType::id},
+          {"[0-9][0-9]*", TokenType::number},
+          {"+", TokenType::plus},
+          {"-", TokenType::minus},
+          {"*", TokenType::star},
+          {"/", TokenType::slash},
+          {"=", TokenType::equals},
+          {"==", TokenType::double_equals},
+          {"(", TokenType::open_paren},
+          {")", TokenType::closed_paren}}};
+
+  // The reserved words of the language. Their perfect hash is built at
+  // compile time, see build_static_keyword_table.
+  static constexpr std::array<std::pair<std::string_view, TokenType>, 7>
+      kBuiltInKeywords = {{
+          {"if", TokenType::if_keyword},
+          {"else", TokenType::else_keyword},
+          {"while", TokenType::while_keyword},
+          {"for", TokenType::for_keyword},
+          {"let", TokenType::let_keyword},
+          {"fn", TokenType::fn_keyword},
+          {"return", TokenType::return_keyword}}};
+
+ private:
+  std::shared_ptr<const LexerProgram> program_;
+  std::string_view input_;
+  std::size_t current_input_idx_;
   bool has_more_;
 
+  void tokenize_range(
+      std::string_view source, std::size_t start_idx, std::size_t end_idx,
+      TokenBuffer* tokens, SymbolTable* symbol_table = nullptr) const;
+  void push_token(
+      int final_state_tag, std::size_t offset, std::size_t length,
+      TokenBuffer* tokens, SymbolTable* symbol_table) const;
+  bool tokenize_chunks(
+      const ChunkReader& read_chunk, const TokenCallback& on_token,
+      std::size_t chunk_size) const;
+
  public:
   Tokenizer();
+  explicit Tokenizer(
+      const std::vector<std::pair<std::string, TokenType>>& token_definitions,
+      const std::vector<std::pair<std::string, TokenType>>& keywords = {});
+  explicit Tokenizer(std::shared_ptr<const LexerProgram> program);
   ~Tokenizer() = default;
-  void tokenize(std::string input);
+  void tokenize(std::string_view input);
   Token get_next_token();
   bool has_more();
+  TokenBuffer tokenize_all(std::string_view source) const;
+  TokenBuffer tokenize_all(
+      std::string_view source, SymbolTable* symbol_table) const;
+  TokenBuffer tokenize_all_parallel(
+      std::string_view source, int number_of_threads,
+      std::size_t min_chunk_size = kMinParallelChunkSize) const;
+  void retokenize(
+      TokenBuffer* tokens, std::string_view edited_source,
+      const TextEdit& edit, SymbolTable* symbol_table = nullptr) const;
+  bool tokenize_stream(
+      std::istream& input, const TokenCallback& on_token,
+      std::size_t chunk_size = kDefaultChunkSize) const;
+  bool tokenize_stream(
+      int file_descriptor, const TokenCallback& on_token,
+      std::size_t chunk_size = kDefaultChunkSize) const;
+  bool save(const std::string& path) const;
+  bool load(const std::string& path);
+  std::shared_ptr<const LexerProgram> get_program() const;
+  int get_number_of_unminimized_states() const;
+  int get_number_of_states() const;
+  int get_number_of_classes() const;
 };
 
 }  // namespace tokenizer
@@ -0,0 +1,232 @@
+#ifndef TOKENIZER_UTF8_H_
+#define TOKENIZER_UTF8_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace tokenizer {
+
+constexpr std::uint32_t kMaxCodePoint = 0x10FFFF;
+constexpr std::uint32_t kFirstSurrogate = 0xD800;
+constexpr std::uint32_t kLastSurrogate = 0xDFFF;
+
+/**
+ * The code points from first to last, both included.
+ */
+struct CodePointRange {
+  std::uint32_t first;
+  std::uint32_t last;
+
+  constexpr bool operator==(const CodePointRange& other) const = default;
+};
+
+/**
+ * A run of UTF-8 bytes where byte idx is between first_bytes[idx] and
+ * last_bytes[idx]. The ranges of split_into_utf8_sequences are chosen so the
+ * strings such a run matches are exactly the encodings of a range of code
+ * points.
+ */
+struct Utf8Sequence {
+  int length = 0;
+  std::array<unsigned char, 4> first_bytes{};
+  std::array<unsigned char, 4> last_bytes{};
+
+  constexpr bool operator==(const Utf8Sequence& other) const = default;
+};
+
+/**
+ * Returns the number of bytes the UTF-8 encoding of a code point takes.
+ */
+constexpr int get_utf8_length(std::uint32_t code_point) {
+  if (code_point < 0x80)
+    return 1;
+  else if (code_point < 0x800)
+    return 2;
+  else if (code_point < 0x10000)
+    return 3;
+  return 4;
+}
+
+/**
+ * Writes the UTF-8 encoding of a code point to bytes and returns its length.
+ */
+constexpr int encode_utf8(std::uint32_t code_point, unsigned char* bytes) {
+  auto length = get_utf8_length(code_point);
+  if (length == 1) {
+    bytes[0] = code_point;
+    return 1;
+  }
+  constexpr unsigned char kLeadBytePrefixes[] = {0, 0, 0xC0, 0xE0, 0xF0};
+  for (auto idx = length - 1; idx > 0; --idx) {
+    bytes[idx] = 0x80 | (code_point & 0x3F);
+    code_point >>= 6;
+  }
+  bytes[0] = kLeadBytePrefixes[length] | code_point;
+  return length;
+}
+
+/**
+ * Returns the length of the character starting at idx: the length of its
+ * UTF-8 sequence if one starts there, or 1 for an ASCII character or a byte
+ * that does not start a valid sequence. Overlong encodings, surrogates and
+ * code points past kMaxCodePoint are not valid.
+ */
+constexpr std::size_t get_character_length(
+    std::string_view input, std::size_t idx) {
+  unsigned char lead_byte = input[idx];
+  std::size_t length = 1;
+  std::uint32_t code_point = 0;
+  if (lead_byte >= 0xC2 && lead_byte <= 0xDF) {
+    length = 2;
+    code_point = lead_byte & 0x1F;
+  } else if (lead_byte >= 0xE0 && lead_byte <= 0xEF) {
+    length = 3;
+    code_point = lead_byte & 0x0F;
+  } else if (lead_byte >= 0xF0 && lead_byte <= 0xF4) {
+    length = 4;
+    code_point = lead_byte & 0x07;
+  }
+  if (length == 1 || idx + length > input.size())
+    return 1;
+  for (std::size_t byte_idx = 1; byte_idx < length; ++byte_idx) {
+    unsigned char continuation_byte = input[idx + byte_idx];
+    if ((continuation_byte & 0xC0) != 0x80)
+      return 1;
+    code_point = code_point << 6 | (continuation_byte & 0x3F);
+  }
+  if (get_utf8_length(code_point) != static_cast<int>(length) ||
+      (code_point >= kFirstSurrogate && code_point <= kLastSurrogate) ||
+      code_point > kMaxCodePoint)
+    return 1;
+  return length;
+}
+
+/**
+ * Returns the code point of the valid UTF-8 sequence of a given length at
+ * idx, see get_character_length.
+ */
+constexpr std::uint32_t decode_utf8(
+    std::string_view input, std::size_t idx, std::size_t length) {
+  constexpr unsigned char kLeadByteMasks[] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+  std::uint32_t code_point =
+      static_cast<unsigned char>(input[idx]) & kLeadByteMasks[length];
+  for (std::size_t byte_idx = 1; byte_idx < length; ++byte_idx) {
+    code_point = code_point << 6 |
+        (static_cast<unsigned char>(input[idx + byte_idx]) & 0x3F);
+  }
+  return code_point;
+}
+
+/**
+ * Sorts ranges and merges the ones that overlap or touch.
+ */
+constexpr std::vector<CodePointRange> normalize_code_point_ranges(
+    std::vector<CodePointRange> ranges) {
+  std::sort(std::begin(ranges), std::end(ranges),
+            [](const CodePointRange& range, const CodePointRange& other_range) {
+              return range.first < other_range.first;
+            });
+  std::vector<CodePointRange> merged_ranges;
+  for (auto range : ranges) {
+    if (!merged_ranges.empty() &&
+        range.first <= merged_ranges.back().last + 1) {
+      merged_ranges.back().last =
+          std::max(merged_ranges.back().last, range.last);
+    } else {
+      merged_ranges.push_back(range);
+    }
+  }
+  return merged_ranges;
+}
+
+/**
+ * Returns the code points up to kMaxCodePoint that are in none of the
+ * ranges. Surrogates are never in the result.
+ */
+constexpr std::vector<CodePointRange> complement_code_point_ranges(
+    std::vector<CodePointRange> ranges) {
+  ranges.push_back({kFirstSurrogate, kLastSurrogate});
+  std::vector<CodePointRange> complement_ranges;
+  std::uint32_t next_code_point = 0;
+  for (auto range : normalize_code_point_ranges(std::move(ranges))) {
+    if (range.first > next_code_point)
+      complement_ranges.push_back({next_code_point, range.first - 1});
+    next_code_point = std::max(next_code_point, range.last + 1);
+  }
+  if (next_code_point <= kMaxCodePoint)
+    complement_ranges.push_back({next_code_point, kMaxCodePoint});
+  return complement_ranges;
+}
+
+/**
+ * Splits a range of code points into runs of byte ranges that together match
+ * the UTF-8 encodings of exactly the code points of the range, skipping
+ * surrogates. A range is first split where the encoded length changes. Then,
+ * while the first and last code point differ in some leading bytes, it is
+ * split so every piece either spans whole blocks of 64 continuation bytes or
+ * fits in one, the same way as for regex engines that match UTF-8 bytes. Each
+ * piece left then encodes to one range per byte.
+ */
+constexpr std::vector<Utf8Sequence> split_into_utf8_sequences(
+    CodePointRange range) {
+  std::vector<Utf8Sequence> sequences;
+  // Ranges still to split, taken from the back so sequences come out in
+  // order of their code points.
+  std::vector<CodePointRange> pending_ranges;
+  if (range.first <= kLastSurrogate && range.last >= kFirstSurrogate) {
+    if (range.last > kLastSurrogate)
+      pending_ranges.push_back({kLastSurrogate + 1, range.last});
+    if (range.first < kFirstSurrogate)
+      pending_ranges.push_back({range.first, kFirstSurrogate - 1});
+  } else {
+    pending_ranges.push_back(range);
+  }
+
+  while (!pending_ranges.empty()) {
+    auto [first, last] = pending_ranges.back();
+    pending_ranges.pop_back();
+    if (first > last || first > kMaxCodePoint)
+      continue;
+    last = std::min(last, kMaxCodePoint);
+
+    auto is_split = false;
+    for (std::uint32_t max_code_point : {0x7F, 0x7FF, 0xFFFF}) {
+      if (first <= max_code_point && last > max_code_point) {
+        pending_ranges.push_back({max_code_point + 1, last});
+        pending_ranges.push_back({first, max_code_point});
+        is_split = true;
+        break;
+      }
+    }
+    for (auto idx = 1; idx < 4 && !is_split; ++idx) {
+      std::uint32_t mask = (std::uint32_t{1} << 6 * idx) - 1;
+      if ((first & ~mask) == (last & ~mask))
+        continue;
+      if ((first & mask) != 0) {
+        pending_ranges.push_back({(first | mask) + 1, last});
+        pending_ranges.push_back({first, first | mask});
+        is_split = true;
+      } else if ((last & mask) != mask) {
+        pending_ranges.push_back({last & ~mask, last});
+        pending_ranges.push_back({first, (last & ~mask) - 1});
+        is_split = true;
+      }
+    }
+    if (is_split)
+      continue;
+
+    Utf8Sequence sequence;
+    sequence.length = encode_utf8(first, sequence.first_bytes.data());
+    encode_utf8(last, sequence.last_bytes.data());
+    sequences.push_back(sequence);
+  }
+  return sequences;
+}
+
+}  // namespace tokenizer
+
+#endif  // TOKENIZER_UTF8_H_
@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "built_in_scanner.h"
+#include "tokenizer/regular_expression.h"
+#include "tokenizer/tokenizer.h"
+
+/**
+ * Generates an expression of roughly the requested size out of a fixed
+ * fragment that exercises every token type. Long fragments use identifiers
+ * and numbers of a few dozen characters.
+ */
+std::string generate_input(std::size_t size, bool has_long_lexemes) {
+  const std::string short_fragment = "(abc12+3456)*x-(98/y7)==value=42";
+  const std::string long_fragment =
+      "(accumulatedvalueofthefirstpartition12+34567890123456789012345)*"
+      "x-(987654321098765432109876/secondpartitionsize7)==totalvalue=42";
+  const auto& fragment = has_long_lexemes ? long_fragment : short_fragment;
+  std::string input;
+  input.reserve(size + fragment.size());
+  while (input.size() < size) {
+    input += fragment;
+    input += "+";
+  }
+  input += "1";
+  return input;
+}
+
+/**
+ * Usage: tokenizer_benchmark [input size in bytes] [repetitions] [short|long]
+ *     [threads]
+ *
+ * The number of threads for tokenize_all_parallel defaults to the number of
+ * cores.
+ */
+int main(int argc, char* argv[]) {
+  std::size_t input_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                    : 1 << 16;
+  int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+  auto has_long_lexemes = argc > 3 && std::string(argv[3]) == "long";
+  int number_of_threads = argc > 4 ? std::atoi(argv[4])
+                                   : std::thread::hardware_concurrency();
+  auto input = generate_input(input_size, has_long_lexemes);
+
+  auto construction_start = std::chrono::steady_clock::now();
+  tokenizer::Tokenizer tokenizer_for_lang;
+  auto construction_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_tokens = 0;
+  auto lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    tokenizer_for_lang.tokenize(input);
+    while (tokenizer_for_lang.has_more()) {
+      tokenizer_for_lang.get_next_token();
+      ++number_of_tokens;
+    }
+  }
+  auto lexing_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_batched_tokens = 0;
+  auto batch_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_batched_tokens += tokenizer_for_lang.tokenize_all(input).size();
+  }
+  auto batch_lexing_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_interned_tokens = 0;
+  tokenizer::SymbolTable symbol_table;
+  auto interned_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_interned_tokens +=
+        tokenizer_for_lang.tokenize_all(input, &symbol_table).size();
+  }
+  auto interned_lexing_end = std::chrono::steady_clock::now();
+
+  // The same token set, run by the scanner generate_scanner emits for it.
+  std::size_t number_of_generated_tokens = 0;
+  auto generated_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_generated_tokens += built_in_scanner::tokenize_all(input).size();
+  }
+  auto generated_lexing_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_parallel_tokens = 0;
+  auto parallel_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_parallel_tokens += tokenizer_for_lang.tokenize_all_parallel(
+        input, number_of_threads).size();
+  }
+  auto parallel_lexing_end = std::chrono::steady_clock::now();
+
+  // The built-in token set without keywords and with 256 of them. A lookup
+  // costs the same for any number of keywords, so both should lex as fast.
+  std::vector<std::pair<std::string, tokenizer::TokenType>> token_definitions;
+  for (const auto& [regex, token_type] :
+       tokenizer::Tokenizer::kBuiltInTokenDefinitions)
+    token_definitions.emplace_back(regex, token_type);
+  std::vector<std::pair<std::string, tokenizer::TokenType>> many_keywords;
+  for (auto idx = 0; idx < 256; ++idx) {
+    many_keywords.emplace_back(
+        "keyword" + std::to_string(idx),
+        static_cast<tokenizer::TokenType>(
+            static_cast<int>(tokenizer::TokenType::if_keyword) + idx % 7));
+  }
+  tokenizer::Tokenizer no_keyword_tokenizer(token_definitions);
+  tokenizer::Tokenizer many_keyword_tokenizer(token_definitions, many_keywords);
+  std::size_t number_of_no_keyword_tokens = 0;
+  auto no_keyword_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_no_keyword_tokens +=
+        no_keyword_tokenizer.tokenize_all(input).size();
+  }
+  auto no_keyword_lexing_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_many_keyword_tokens = 0;
+  auto many_keyword_lexing_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    number_of_many_keyword_tokens +=
+        many_keyword_tokenizer.tokenize_all(input).size();
+  }
+  auto many_keyword_lexing_end = std::chrono::steady_clock::now();
+
+  // Searching for a fragment of the input, once with find_all and once by
+  // trying to match at every offset.
+  tokenizer::RegularExpression search_regex("value=[0-9]*");
+  std::size_t number_of_search_matches = 0;
+  auto search_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition)
+    number_of_search_matches += search_regex.find_all(input).size();
+  auto search_end = std::chrono::steady_clock::now();
+
+  std::size_t number_of_restarting_search_matches = 0;
+  auto restarting_search_start = std::chrono::steady_clock::now();
+  for (auto repetition = 0; repetition < repetitions; ++repetition) {
+    for (std::size_t idx = 0; idx < input.size();) {
+      auto match_length = search_regex.match_length(input, idx);
+      number_of_restarting_search_matches += match_length != 0;
+      idx += match_length != 0 ? match_length : 1;
+    }
+  }
+  auto restarting_search_end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double> construction_time =
+      construction_end - construction_start;
+  std::chrono::duration<double> lexing_time = lexing_end - lexing_start;
+  std::chrono::duration<double> batch_lexing_time =
+      batch_lexing_end - batch_lexing_start;
+  std::chrono::duration<double> interned_lexing_time =
+      interned_lexing_end - interned_lexing_start;
+  std::chrono::duration<double> generated_lexing_time =
+      generated_lexing_end - generated_lexing_start;
+  std::chrono::duration<double> parallel_lexing_time =
+      parallel_lexing_end - parallel_lexing_start;
+  std::chrono::duration<double> no_keyword_lexing_time =
+      no_keyword_lexing_end - no_keyword_lexing_start;
+  std::chrono::duration<double> many_keyword_lexing_time =
+      many_keyword_lexing_end - many_keyword_lexing_start;
+  std::chrono::duration<double> search_time = search_end - search_start;
+  std::chrono::duration<double> restarting_search_time =
+      restarting_search_end - restarting_search_start;
+  auto bytes_lexed = static_cast<double>(input.size()) * repetitions;
+
+  std::cout << "construction: " << construction_time.count() * 1e3 << " ms\n"
+            << "input: " << input.size() << " bytes x " << repetitions << "\n"
+            << "tokens: " << number_of_tokens << "\n"
+            << "lexing: " << lexing_time.count() * 1e3 << " ms\n"
+            << "throughput: " << bytes_lexed / lexing_time.count() / 1e6
+            << " MB/s\n"
+            << "batch tokens: " << number_of_batched_tokens << "\n"
+            << "batch lexing: " << batch_lexing_time.count() * 1e3 << " ms\n"
+            << "batch throughput: "
+            << bytes_lexed / batch_lexing_time.count() / 1e6 << " MB/s\n"
+            << "interned tokens: " << number_of_interned_tokens << " with "
+            << symbol_table.size() << " symbols\n"
+            << "interned lexing: " << interned_lexing_time.count() * 1e3
+            << " ms\n"
+            << "interned throughput: "
+            << bytes_lexed / interned_lexing_time.count() / 1e6 << " MB/s\n"
+            << "generated tokens: " << number_of_generated_tokens << "\n"
+            << "generated lexing: " << generated_lexing_time.count() * 1e3
+            << " ms\n"
+            << "generated throughput: "
+            << bytes_lexed / generated_lexing_time.count() / 1e6 << " MB/s\n"
+            << "parallel tokens: " << number_of_parallel_tokens << " on "
+            << number_of_threads << " threads\n"
+            << "parallel lexing: " << parallel_lexing_time.count() * 1e3
+            << " ms\n"
+            << "parallel throughput: "
+            << bytes_lexed / parallel_lexing_time.count() / 1e6 << " MB/s\n"
+            << "no keyword tokens: " << number_of_no_keyword_tokens << "\n"
+            << "no keyword throughput: "
+            << bytes_lexed / no_keyword_lexing_time.count() / 1e6 << " MB/s\n"
+            << "256 keyword tokens: " << number_of_many_keyword_tokens << "\n"
+            << "256 keyword throughput: "
+            << bytes_lexed / many_keyword_lexing_time.count() / 1e6
+            << " MB/s\n"
+            << "search matches: " << number_of_search_matches << "\n"
+            << "search: " << search_time.count() * 1e3 << " ms\n"
+            << "search throughput: "
+            << bytes_lexed / search_time.count() / 1e6 << " MB/s\n"
+            << "restarting search matches: "
+            << number_of_restarting_search_matches << "\n"
+            << "restarting search: " << restarting_search_time.count() * 1e3
+            << " ms\n"
+            << "restarting search throughput: "
+            << bytes_lexed / restarting_search_time.count() / 1e6
+            << " MB/s\n";
+  return 0;
+}